@@ -41,7 +41,7 @@
 
 #include "fbe-remote-generated.h"
 #include "pages/branding-welcome/gis-branding-welcome-page.h"
-#include "pages/language/cc-common-language.h"
+#include "pages/locale/cc-common-language.h"
 #include "pages/language/gis-language-page.h"
 #include "pages/keyboard/gis-keyboard-page.h"
 #include "pages/display/gis-display-page.h"
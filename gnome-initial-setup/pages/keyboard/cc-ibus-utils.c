@@ -18,8 +18,13 @@
 #include <config.h>
 
 #ifdef HAVE_IBUS
+#include <glib/gstdio.h>
+
 #include "cc-ibus-utils.h"
 
+/* Engine list from the last run, see engine_cache_load() */
+#define ENGINE_CACHE_TYPE "(sav)"
+
 gchar *
 engine_get_display_name (IBusEngineDesc *engine_desc)
 {
@@ -40,4 +45,188 @@ engine_get_display_name (IBusEngineDesc *engine_desc)
         return display_name;
 }
 
+static gchar *
+get_engine_cache_path (void)
+{
+        return g_build_filename (g_get_user_cache_dir (),
+                                 "gnome-initial-setup",
+                                 "ibus-engines",
+                                 NULL);
+}
+
+/* The engines are described by the IBus components, so installing or
+ * removing one changes one of these directories */
+static gchar *
+get_engine_cache_key (void)
+{
+        gchar *dirs[2];
+        GString *key;
+        guint i;
+
+        dirs[0] = g_strdup (IBUS_COMPONENT_DIR);
+        dirs[1] = g_build_filename (g_get_user_data_dir (), "ibus", "component", NULL);
+
+        key = g_string_new (PACKAGE_VERSION);
+        g_string_append_printf (key, ";%d.%d.%d",
+                                IBUS_MAJOR_VERSION, IBUS_MINOR_VERSION, IBUS_MICRO_VERSION);
+        for (i = 0; i < G_N_ELEMENTS (dirs); i++) {
+                GStatBuf buf;
+
+                if (g_stat (dirs[i], &buf) == 0)
+                        g_string_append_printf (key, ";%" G_GINT64_FORMAT, (gint64) buf.st_mtime);
+                g_free (dirs[i]);
+        }
+
+        return g_string_free (key, FALSE);
+}
+
+/* ibus_serializable_deserialize() trusts its input, so only hand it
+ * what IBus itself would have written for an engine: the same type as
+ * a fresh IBusEngineDesc, and no attachments, which would be
+ * deserialized in turn */
+static gboolean
+is_engine_desc_variant (GVariant *value)
+{
+        static GVariantType *engine_type = NULL;
+        GVariant *attachments;
+        const gchar *name;
+        gboolean ret;
+
+        if (g_once_init_enter (&engine_type)) {
+                IBusEngineDesc *desc;
+                GVariant *serialized;
+
+                desc = ibus_engine_desc_new ("", "", "", "", "", "", "", "");
+                serialized = ibus_serializable_serialize (IBUS_SERIALIZABLE (desc));
+                g_variant_ref_sink (serialized);
+                g_once_init_leave (&engine_type,
+                                   g_variant_type_copy (g_variant_get_type (serialized)));
+                g_variant_unref (serialized);
+                g_object_unref (desc);
+        }
+
+        if (!g_variant_is_of_type (value, engine_type))
+                return FALSE;
+
+        g_variant_get_child (value, 0, "&s", &name);
+        attachments = g_variant_get_child_value (value, 1);
+        ret = g_str_equal (name, "IBusEngineDesc") &&
+              g_variant_n_children (attachments) == 0;
+        g_variant_unref (attachments);
+
+        return ret;
+}
+
+/**
+ * engine_cache_load:
+ *
+ * Reads the engines which the IBus daemon listed on the last run, if
+ * no component was installed or removed since.  A cache with anything
+ * but engines in it is ignored.
+ *
+ * Returns: (transfer full): a list of #IBusEngineDesc, or %NULL
+ */
+GList *
+engine_cache_load (void)
+{
+        GVariant *cache, *engines;
+        gchar *path, *key, *contents;
+        const gchar *cached_key;
+        GList *list = NULL;
+        gsize length, i;
+
+        path = get_engine_cache_path ();
+        if (!g_file_get_contents (path, &contents, &length, NULL)) {
+                g_free (path);
+                return NULL;
+        }
+        g_free (path);
+
+        cache = g_variant_new_from_data (G_VARIANT_TYPE (ENGINE_CACHE_TYPE),
+                                         contents, length, FALSE,
+                                         g_free, contents);
+        g_variant_ref_sink (cache);
+
+        key = get_engine_cache_key ();
+        g_variant_get (cache, "(&s@av)", &cached_key, &engines);
+        if (g_strcmp0 (cached_key, key) == 0) {
+                for (i = g_variant_n_children (engines); i > 0; i--) {
+                        GVariant *child, *value;
+                        IBusSerializable *engine = NULL;
+
+                        child = g_variant_get_child_value (engines, i - 1);
+                        value = g_variant_get_variant (child);
+                        if (is_engine_desc_variant (value))
+                                engine = ibus_serializable_deserialize (value);
+                        g_variant_unref (value);
+                        g_variant_unref (child);
+
+                        if (!IBUS_IS_ENGINE_DESC (engine)) {
+                                g_debug ("Ignoring invalid IBus engine cache");
+                                g_clear_object (&engine);
+                                g_list_free_full (list, g_object_unref);
+                                list = NULL;
+                                break;
+                        }
+                        list = g_list_prepend (list, engine);
+                }
+        }
+
+        g_variant_unref (engines);
+        g_variant_unref (cache);
+        g_free (key);
+
+        return list;
+}
+
+static void
+engine_cache_saved_cb (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+        GError *error = NULL;
+
+        if (!g_file_replace_contents_finish (G_FILE (source_object), result, NULL, &error)) {
+                g_debug ("Could not save IBus engine cache: %s", error->message);
+                g_error_free (error);
+        }
+}
+
+/* Written asynchronously, as it is called from the reply to the
+ * engine list request on the main thread */
+void
+engine_cache_save (GList *engines)
+{
+        GVariantBuilder builder;
+        GVariant *cache;
+        GBytes *bytes;
+        GFile *file;
+        gchar *path, *dir, *key;
+
+        key = get_engine_cache_key ();
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("av"));
+        for (; engines != NULL; engines = engines->next)
+                g_variant_builder_add (&builder, "v",
+                                       ibus_serializable_serialize (IBUS_SERIALIZABLE (engines->data)));
+        cache = g_variant_ref_sink (g_variant_new ("(s@av)", key,
+                                                   g_variant_builder_end (&builder)));
+        g_free (key);
+
+        path = get_engine_cache_path ();
+        dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (dir, 0755);
+
+        file = g_file_new_for_path (path);
+        bytes = g_variant_get_data_as_bytes (cache);
+        g_file_replace_contents_bytes_async (file, bytes, NULL, FALSE,
+                                             G_FILE_CREATE_REPLACE_DESTINATION,
+                                             NULL, engine_cache_saved_cb, NULL);
+
+        g_bytes_unref (bytes);
+        g_object_unref (file);
+        g_variant_unref (cache);
+        g_free (dir);
+        g_free (path);
+}
+
 #endif /* HAVE_IBUS */
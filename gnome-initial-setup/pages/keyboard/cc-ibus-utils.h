@@ -23,6 +23,8 @@
 G_BEGIN_DECLS
 
 gchar *engine_get_display_name (IBusEngineDesc *engine_desc);
+GList *engine_cache_load       (void);
+void   engine_cache_save       (GList          *engines);
 
 G_END_DECLS
 
@@ -30,7 +30,6 @@
 
 #define GNOME_DESKTOP_USE_UNSTABLE_API
 #include <libgnome-desktop/gnome-languages.h>
-#include <libgnome-desktop/gnome-xkb-info.h>
 
 #ifdef HAVE_IBUS
 #include <ibus.h>
@@ -38,7 +37,10 @@
 #endif
 
 #include "cc-common-language.h"
+#include "cc-keyboard-hints.h"
+#include "cc-keyboard-preview.h"
 #include "cc-util.h"
+#include "cc-xkb-cache.h"
 
 #include <glib-object.h>
 
@@ -47,6 +49,9 @@
 
 #define MIN_ROWS 6
 
+/* Time spent creating extra rows per main loop iteration */
+#define ROW_BATCH_BUDGET_US 8000
+
 struct _CcInputChooserPrivate
 {
         GtkWidget *filter_entry;
@@ -56,12 +61,21 @@ struct _CcInputChooserPrivate
         GtkWidget *scrolled_window;
         GtkWidget *no_results;
         GtkWidget *more_item;
+        GtkWidget *preview_popover;
+        GtkWidget *preview;
 
         gboolean showing_extra;
+
+        /* Extra inputs have no row until "More" is activated; they
+         * are then added a batch per idle, see add_extra_rows() */
+        GPtrArray *pending_inputs;
+        guint next_pending;
+        guint add_rows_id;
+
 	gchar *locale;
         gchar *id;
 	gchar *type;
-	GnomeXkbInfo *xkb_info;
+	CcXkbCache *xkb_info;
 #ifdef HAVE_IBUS
         IBusBus *ibus;
         GHashTable *ibus_engines;
@@ -137,9 +151,9 @@ get_layout (CcInputChooser *chooser,
         CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
 
 	if (g_strcmp0 (type, INPUT_SOURCE_TYPE_XKB) == 0) {
-		gnome_xkb_info_get_layout_info (priv->xkb_info,
-						id, NULL, NULL,
-						layout, variant);
+		cc_xkb_cache_get_layout_info (priv->xkb_info,
+					      id, NULL, NULL,
+					      layout, variant);
                 return TRUE;
         }
 #ifdef HAVE_IBUS
@@ -165,11 +179,11 @@ preview_cb (GtkLabel       *label,
 	    const gchar    *uri,
 	    CcInputChooser *chooser)
 {
+        CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
 	GtkWidget *row;
 	InputWidget *widget;
 	const gchar *layout;
 	const gchar *variant;
-	gchar *commandline;
 
 	row = gtk_widget_get_parent (GTK_WIDGET (label));
 	widget = get_input_widget (row);
@@ -177,12 +191,23 @@ preview_cb (GtkLabel       *label,
 	if (!get_layout (chooser, widget->type, widget->id, &layout, &variant))
 		return TRUE;
 
-	if (variant[0])
-		commandline = g_strdup_printf ("gkbd-keyboard-display -l \"%s\t%s\"", layout, variant);
-	else
-		commandline = g_strdup_printf ("gkbd-keyboard-display -l %s", layout);
-	g_spawn_command_line_async (commandline, NULL);
-	g_free (commandline);
+        /* One popover is moved between the rows */
+        if (priv->preview_popover == NULL) {
+                priv->preview_popover = gtk_popover_new (GTK_WIDGET (label));
+                g_object_add_weak_pointer (G_OBJECT (priv->preview_popover),
+                                           (gpointer *) &priv->preview_popover);
+
+                priv->preview = cc_keyboard_preview_new ();
+                gtk_container_set_border_width (GTK_CONTAINER (priv->preview_popover), 10);
+                gtk_container_add (GTK_CONTAINER (priv->preview_popover), priv->preview);
+                gtk_widget_show (priv->preview);
+        } else {
+                gtk_popover_set_relative_to (GTK_POPOVER (priv->preview_popover),
+                                             GTK_WIDGET (label));
+        }
+
+        cc_keyboard_preview_set_layout (CC_KEYBOARD_PREVIEW (priv->preview), layout, variant);
+        gtk_widget_show (priv->preview_popover);
 
 	return TRUE;
 }
@@ -200,7 +225,7 @@ input_widget_new (CcInputChooser *chooser,
 	gchar *text;
 
 	if (g_str_equal (type, INPUT_SOURCE_TYPE_XKB)) {
-		gnome_xkb_info_get_layout_info (priv->xkb_info, id, &name, NULL, NULL, NULL);
+		cc_xkb_cache_get_layout_info (priv->xkb_info, id, &name, NULL, NULL, NULL);
 	}
 #ifdef HAVE_IBUS
         else if (g_str_equal (type, INPUT_SOURCE_TYPE_IBUS)) {
@@ -321,6 +346,97 @@ no_results_widget_new (void)
         return widget;
 }
 
+typedef struct {
+        gchar *type;
+        gchar *id;
+} PendingInput;
+
+static void
+pending_input_free (gpointer data)
+{
+        PendingInput *pending = data;
+
+        g_free (pending->type);
+        g_free (pending->id);
+        g_free (pending);
+}
+
+static void
+add_row (CcInputChooser *chooser,
+         const gchar    *type,
+         const gchar    *id,
+         gboolean        is_extra)
+{
+        CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
+        GtkWidget *widget;
+
+        widget = input_widget_new (chooser, type, id, is_extra);
+        gtk_container_add (GTK_CONTAINER (priv->input_list), widget);
+        sync_checkmark (gtk_widget_get_parent (widget), chooser);
+}
+
+static void
+add_pending_row (CcInputChooser *chooser,
+                 PendingInput   *pending)
+{
+        if (pending->id == NULL)
+                return;
+
+        add_row (chooser, pending->type, pending->id, TRUE);
+        g_clear_pointer (&pending->id, g_free);
+}
+
+static gboolean
+add_extra_rows_idle (gpointer user_data)
+{
+        CcInputChooser *chooser = user_data;
+        CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
+        gint64 deadline;
+
+        deadline = g_get_monotonic_time () + ROW_BATCH_BUDGET_US;
+
+        while (priv->next_pending < priv->pending_inputs->len) {
+                add_pending_row (chooser, g_ptr_array_index (priv->pending_inputs,
+                                                             priv->next_pending++));
+
+                if (g_get_monotonic_time () >= deadline)
+                        return G_SOURCE_CONTINUE;
+        }
+
+        priv->add_rows_id = 0;
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+add_extra_rows (CcInputChooser *chooser)
+{
+        CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
+
+        if (priv->add_rows_id != 0 || priv->next_pending >= priv->pending_inputs->len)
+                return;
+
+        priv->add_rows_id = g_idle_add (add_extra_rows_idle, chooser);
+}
+
+/* The selected input is always shown, so it can't wait for the idle */
+static void
+add_selected_row (CcInputChooser *chooser)
+{
+        CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
+        guint i;
+
+        for (i = priv->next_pending; i < priv->pending_inputs->len; i++) {
+                PendingInput *pending = g_ptr_array_index (priv->pending_inputs, i);
+
+                if (g_strcmp0 (pending->id, priv->id) == 0 &&
+                    g_strcmp0 (pending->type, priv->type) == 0) {
+                        add_pending_row (chooser, pending);
+                        break;
+                }
+        }
+}
+
 static int
 add_rows_to_list (CcInputChooser  *chooser,
 	          GList            *list,
@@ -330,7 +446,6 @@ add_rows_to_list (CcInputChooser  *chooser,
 {
         CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
 	const gchar *id;
-	GtkWidget *widget;
 	gchar *key;
 	int rows_added = 0;
 
@@ -350,10 +465,21 @@ add_rows_to_list (CcInputChooser  *chooser,
 
 		if (g_hash_table_size (priv->inputs) > MIN_ROWS)
 			is_extra = TRUE;
-		widget = input_widget_new (chooser, type, id, is_extra);
-		gtk_container_add (GTK_CONTAINER (priv->input_list), widget);
+
+		if (is_extra) {
+			PendingInput *pending = g_new (PendingInput, 1);
+
+			pending->type = g_strdup (type);
+			pending->id = g_strdup (id);
+			g_ptr_array_add (priv->pending_inputs, pending);
+		} else {
+			add_row (chooser, type, id, FALSE);
+		}
 	}
 
+	if (priv->showing_extra)
+		add_extra_rows (chooser);
+
 	return rows_added;
 }
 
@@ -373,10 +499,23 @@ get_locale_infos (CcInputChooser *chooser)
 {
         CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
 	const gchar *type, *id;
+	const gchar *hint;
 	gchar *lang, *country;
 	GList *list;
 	int non_extra_layouts = 0;
 
+	/* A layout the hardware tells us about beats any guess from the
+	 * locale.
+	 */
+	hint = cc_keyboard_hints_get_layout ();
+	if (hint && cc_xkb_cache_get_layout_info (priv->xkb_info, hint, NULL, NULL, NULL, NULL)) {
+		non_extra_layouts += add_row_to_list (chooser, INPUT_SOURCE_TYPE_XKB, hint, FALSE);
+		if (!priv->id) {
+			priv->id = g_strdup (hint);
+			priv->type = g_strdup (INPUT_SOURCE_TYPE_XKB);
+		}
+	}
+
 	if (gnome_get_input_source_from_locale (priv->locale, &type, &id)) {
 		non_extra_layouts += add_row_to_list (chooser, type, id, FALSE);
 		if (!priv->id) {
@@ -388,11 +527,11 @@ get_locale_infos (CcInputChooser *chooser)
 	if (!gnome_parse_locale (priv->locale, &lang, &country, NULL, NULL))
 		goto out;
 
-	list = gnome_xkb_info_get_layouts_for_language (priv->xkb_info, lang);
+	list = cc_xkb_cache_get_layouts_for_language (priv->xkb_info, lang);
 	non_extra_layouts += add_rows_to_list (chooser, list, INPUT_SOURCE_TYPE_XKB, id, FALSE);
 	g_list_free (list);
 
-	list = gnome_xkb_info_get_layouts_for_country (priv->xkb_info, country);
+	list = cc_xkb_cache_get_layouts_for_country (priv->xkb_info, country);
 	non_extra_layouts += add_rows_to_list (chooser, list, INPUT_SOURCE_TYPE_XKB, id, FALSE);
 	g_list_free (list);
 
@@ -404,7 +543,7 @@ get_locale_infos (CcInputChooser *chooser)
 		add_row_to_list (chooser, INPUT_SOURCE_TYPE_XKB, "us+intl", FALSE);
 	}
 
-	list = gnome_xkb_info_get_all_layouts (priv->xkb_info);
+	list = cc_xkb_cache_get_all_layouts (priv->xkb_info);
 	add_rows_to_list (chooser, list, INPUT_SOURCE_TYPE_XKB, id, TRUE);
 	g_list_free (list);
 
@@ -503,6 +642,7 @@ show_more (CcInputChooser *chooser)
 	gtk_widget_set_valign (GTK_WIDGET (chooser), GTK_ALIGN_FILL);
 
         priv->showing_extra = TRUE;
+        add_extra_rows (chooser);
         gtk_list_box_invalidate_filter (GTK_LIST_BOX (priv->input_list));
         g_object_notify_by_pspec (G_OBJECT (chooser), obj_props[PROP_SHOWING_EXTRA]);
 }
@@ -523,6 +663,7 @@ set_input (CcInputChooser *chooser,
         priv->id = g_strdup (id);
 	priv->type = g_strdup (type);
 
+        add_selected_row (chooser);
         sync_all_checkmarks (chooser);
 
 	g_signal_emit (chooser, signals[CHANGED], 0);
@@ -629,13 +770,39 @@ get_ibus_locale_infos (CcInputChooser *chooser)
 	  add_row_to_list (chooser, INPUT_SOURCE_TYPE_IBUS, engine_id, TRUE);
 }
 
+/* Takes ownership of @list */
+static void
+set_ibus_engines (CcInputChooser *chooser,
+                  GList          *list)
+{
+        CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
+        GList *l;
+
+        g_clear_pointer (&priv->ibus_engines, g_hash_table_destroy);
+
+        /* Maps engine ids to engine description objects */
+        priv->ibus_engines = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+
+        for (l = list; l; l = l->next) {
+                IBusEngineDesc *engine = l->data;
+                const gchar *engine_id;
+
+		engine_id = ibus_engine_desc_get_name (engine);
+                if (g_str_has_prefix (engine_id, "xkb:"))
+                        g_object_unref (engine);
+                else
+			g_hash_table_replace (priv->ibus_engines, (gpointer)engine_id, engine);
+	}
+	g_list_free (list);
+}
+
 static void
 fetch_ibus_engines_result (GObject       *object,
                            GAsyncResult  *result,
                            CcInputChooser *chooser)
 {
         CcInputChooserPrivate *priv;
-        GList *list, *l;
+        GList *list;
         GError *error;
 
         error = NULL;
@@ -650,23 +817,14 @@ fetch_ibus_engines_result (GObject       *object,
         priv = cc_input_chooser_get_instance_private (chooser);
         g_clear_object (&priv->ibus_cancellable);
 
-        /* Maps engine ids to engine description objects */
-        priv->ibus_engines = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
-
-        for (l = list; l; l = l->next) {
-                IBusEngineDesc *engine = l->data;
-                const gchar *engine_id;
-
-		engine_id = ibus_engine_desc_get_name (engine);
-                if (g_str_has_prefix (engine_id, "xkb:"))
-                        g_object_unref (engine);
-                else
-			g_hash_table_replace (priv->ibus_engines, (gpointer)engine_id, engine);
-	}
-	g_list_free (list);
+        /* Rows may already have been made from the cached engines;
+         * this refreshes them and adds any new ones */
+        engine_cache_save (list);
+        set_ibus_engines (chooser, list);
 
 	update_ibus_active_sources (chooser);
 	get_ibus_locale_infos (chooser);
+	add_selected_row (chooser);
 
         sync_all_checkmarks (chooser);
 }
@@ -710,13 +868,22 @@ cc_input_chooser_constructed (GObject *object)
 {
         CcInputChooser *chooser = CC_INPUT_CHOOSER (object);
         CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
+#ifdef HAVE_IBUS
+        GList *list;
+#endif
 
         G_OBJECT_CLASS (cc_input_chooser_parent_class)->constructed (object);
 
-	priv->xkb_info = gnome_xkb_info_new ();
+	priv->xkb_info = cc_xkb_cache_get_default ();
 
 #ifdef HAVE_IBUS
         ibus_init ();
+
+        /* The daemon only refreshes these, in the background */
+        list = engine_cache_load ();
+        if (list != NULL)
+                set_ibus_engines (chooser, list);
+
         if (!priv->ibus) {
                 priv->ibus = ibus_bus_new_async ();
                 if (ibus_bus_is_connected (priv->ibus))
@@ -729,6 +896,7 @@ cc_input_chooser_constructed (GObject *object)
 #endif
 
 	priv->inputs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        priv->pending_inputs = g_ptr_array_new_with_free_func (pending_input_free);
         priv->more_item = more_widget_new ();
         priv->no_results = no_results_widget_new ();
 
@@ -749,6 +917,7 @@ cc_input_chooser_constructed (GObject *object)
 #ifdef HAVE_IBUS
 	get_ibus_locale_infos (chooser);
 #endif
+        add_selected_row (chooser);
 
         gtk_container_add (GTK_CONTAINER (priv->input_list), priv->more_item);
         gtk_list_box_set_placeholder (GTK_LIST_BOX (priv->input_list), priv->no_results);
@@ -763,18 +932,40 @@ cc_input_chooser_constructed (GObject *object)
         sync_all_checkmarks (chooser);
 }
 
+static void
+cc_input_chooser_dispose (GObject *object)
+{
+        CcInputChooser *chooser = CC_INPUT_CHOOSER (object);
+        CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
+
+        if (priv->add_rows_id != 0) {
+                g_source_remove (priv->add_rows_id);
+                priv->add_rows_id = 0;
+        }
+
+#ifdef HAVE_IBUS
+        if (priv->ibus_cancellable)
+                g_cancellable_cancel (priv->ibus_cancellable);
+#endif
+
+        G_OBJECT_CLASS (cc_input_chooser_parent_class)->dispose (object);
+}
+
 static void
 cc_input_chooser_finalize (GObject *object)
 {
 	CcInputChooser *chooser = CC_INPUT_CHOOSER (object);
         CcInputChooserPrivate *priv = cc_input_chooser_get_instance_private (chooser);
 
-	g_clear_object (&priv->xkb_info);
+	if (priv->preview_popover != NULL)
+		g_object_remove_weak_pointer (G_OBJECT (priv->preview_popover),
+					      (gpointer *) &priv->preview_popover);
+
+	g_clear_pointer (&priv->xkb_info, cc_xkb_cache_unref);
 	g_hash_table_unref (priv->inputs);
+	g_ptr_array_unref (priv->pending_inputs);
 #ifdef HAVE_IBUS
         g_clear_object (&priv->ibus);
-        if (priv->ibus_cancellable)
-                g_cancellable_cancel (priv->ibus_cancellable);
         g_clear_object (&priv->ibus_cancellable);
         g_clear_pointer (&priv->ibus_engines, g_hash_table_destroy);
 #endif
@@ -810,6 +1001,7 @@ cc_input_chooser_class_init (CcInputChooserClass *klass)
         gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass), CcInputChooser, input_list);
         gtk_widget_class_bind_template_child_private (GTK_WIDGET_CLASS (klass), CcInputChooser, scrolled_window);
 
+        object_class->dispose = cc_input_chooser_dispose;
 	object_class->finalize = cc_input_chooser_finalize;
         object_class->get_property = cc_input_chooser_get_property;
         object_class->constructed = cc_input_chooser_constructed;
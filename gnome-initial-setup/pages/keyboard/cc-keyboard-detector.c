@@ -20,9 +20,10 @@
  */
 
 #include <config.h>
+
 #include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
+
+#include <gio/gio.h>
 
 #include "cc-keyboard-detector.h"
 
@@ -30,7 +31,7 @@ KeyboardDetector *
 keyboard_detector_new (void)
 {
   GError *error = NULL;
-  GInputStream *istream;
+  GBytes *bytes;
   KeyboardDetector *det;
   const gchar * const *language_names = g_get_language_names ();
   const gchar *language_name;
@@ -40,14 +41,14 @@ keyboard_detector_new (void)
   for (idx = 0; (language_name = language_names[idx]) != NULL; idx++)
     {
       gchar *path = g_strdup_printf (
-          "/org/gnome/initial-setup/detector-trees/%s/pc105.tree",
+          "/org/gnome/initial-setup/detector-trees/%s/pc105.steps",
           language_name);
       g_clear_error (&error);
-      istream = g_resources_open_stream (path,
-                                         G_RESOURCE_LOOKUP_FLAGS_NONE, &error);
+      bytes = g_resources_lookup_data (path,
+                                       G_RESOURCE_LOOKUP_FLAGS_NONE, &error);
       g_free (path);
 
-      if (istream == NULL)
+      if (bytes == NULL)
         {
           g_debug ("Unable to load keyboard detector tree for %s: %s",
                    language_name, error->message);
@@ -63,14 +64,25 @@ keyboard_detector_new (void)
         }
     }
 
-  if (istream == NULL)
+  if (bytes == NULL)
     g_error ("Error loading keyboard detector tree: %s", error->message);
 
   det = g_new0 (KeyboardDetector, 1);
 
   det->current_step = -1;
-  det->fp = g_data_input_stream_new (istream);
-  g_object_unref (istream);
+  /* Compiled by detector-tree-compile at build time */
+  det->tree = g_variant_new_from_bytes (G_VARIANT_TYPE ("a" DETECTOR_STEP_TYPE),
+                                        bytes, TRUE);
+  g_variant_ref_sink (det->tree);
+  g_bytes_unref (bytes);
+  if (G_BYTE_ORDER == G_BIG_ENDIAN)
+    {
+      GVariant *swapped = g_variant_byteswap (det->tree);
+
+      g_variant_unref (det->tree);
+      det->tree = swapped;
+    }
+  det->history = g_array_new (FALSE, FALSE, sizeof (int));
 
   det->keycodes = g_hash_table_new (NULL, NULL);
   det->symbols = NULL;
@@ -86,190 +98,248 @@ static void
 keyboard_detector_clear (KeyboardDetector *det)
 {
   g_hash_table_remove_all (det->keycodes);
-  g_list_foreach (det->symbols, (GFunc) g_free, NULL);
   g_clear_pointer (&det->symbols, g_list_free);
   det->present = -1;
   det->not_present = -1;
   det->step_type = UNKNOWN;
-  g_clear_pointer (&det->result, g_free);
+  det->result = NULL;
 }
 
 void
 keyboard_detector_free (KeyboardDetector *det)
 {
   keyboard_detector_clear (det);
-  g_object_unref (det->fp);
+  g_variant_unref (det->tree);
+  g_array_unref (det->history);
   g_hash_table_destroy (det->keycodes);
   g_free (det);
 }
 
-/* Return value: TRUE if should read another line */
-static gboolean
-process_line (KeyboardDetector         *det,
-              KeyboardDetectorStepType  step,
-              char                     *line,
-              KeyboardDetectorStepType *result)
+static KeyboardDetectorStepType
+load_step (KeyboardDetector *det,
+           int               step)
 {
-  if (g_str_has_prefix (line, "STEP "))
-    {
-      /* This line starts a new step. */
-      int new_step = atoi (line + 5);
-      if (det->current_step == step)
-        {
-          det->current_step = new_step;
-          *result = det->step_type;
-          return FALSE;
-        }
-      else
-        {
-          det->current_step = new_step;
-        }
-    }
-  else if (det->current_step != step)
-    return TRUE;
-  else if (g_str_has_prefix (line, "PRESS "))
+  GVariant *record, *symbols, *codes;
+  guchar type;
+  const char *result;
+  gsize i, n;
+
+  keyboard_detector_clear (det);
+
+  if (step < 0 || (gsize) step >= g_variant_n_children (det->tree))
+    return ERROR;
+
+  record = g_variant_get_child_value (det->tree, step);
+  g_variant_get (record, "(y@as@a(ii)ii&s)", &type, &symbols, &codes,
+                 &det->present, &det->not_present, &result);
+  g_variant_unref (record);
+
+  n = g_variant_n_children (symbols);
+  for (i = n; i > 0; i--)
     {
-      /* Ask the user to press a character on the keyboard. */
-      if (det->step_type == UNKNOWN)
-        det->step_type = PRESS_KEY;
-      if (det->step_type != PRESS_KEY)
-        {
-          *result = ERROR;
-          return FALSE;
-        }
-      char *key_symbol = g_strdup (g_strstrip (line + 6));
-      det->symbols = g_list_append (det->symbols, key_symbol);
+      const char *symbol;
+
+      g_variant_get_child (symbols, i - 1, "&s", &symbol);
+      det->symbols = g_list_prepend (det->symbols, (gpointer) symbol);
     }
-  else if (g_str_has_prefix (line, "CODE "))
+
+  n = g_variant_n_children (codes);
+  for (i = 0; i < n; i++)
     {
-      /* Direct the evaluating code to process step ## next if the
-       * user has pressed a key which returned that keycode.
-       */
-      if (det->step_type != PRESS_KEY)
-        {
-          *result = ERROR;
-          return FALSE;
-        }
-      char *keycode = strtok (line + 5, " ");
-      char *s = strtok (NULL, " ");
-      int code = atoi (keycode);
-      int next_step = atoi (s);
+      int code, next_step;
+
+      g_variant_get_child (codes, i, "(ii)", &code, &next_step);
       g_hash_table_insert (det->keycodes, GINT_TO_POINTER (code), GINT_TO_POINTER (next_step));
     }
-  else if (g_str_has_prefix (line, "FIND "))
-    {
-      /* Ask the user whether that character is present on their
-       * keyboard.
-       */
-      if (det->step_type == UNKNOWN)
-        {
-          det->step_type = KEY_PRESENT;
-        }
-      else
-        {
-          *result = ERROR;
-          return FALSE;
-        }
-      char *key_symbol = g_strdup (g_strstrip (line + 5));
-      det->symbols = g_list_prepend (det->symbols, key_symbol);
-    }
-  else if (g_str_has_prefix (line, "FINDP "))
-    {
-      /* Equivalent to FIND, except that the user is asked to consider
-       * only the primary symbols (i.e. Plain and Shift).
-       */
-      if (det->step_type == UNKNOWN)
-        {
-          det->step_type = KEY_PRESENT_P;
-        }
-      else
-        {
-          *result = ERROR;
-          return FALSE;
-        }
-      char *key_symbol = g_strdup (g_strstrip (line + 6));
-      det->symbols = g_list_prepend (det->symbols, key_symbol);
-    }
-  else if (g_str_has_prefix (line, "YES "))
-    {
-      /* Direct the evaluating code to process step ## next if the
-       * user does have this key.
-       */
-      if (det->step_type != KEY_PRESENT_P &&
-          det->step_type != KEY_PRESENT)
-        {
-          *result = ERROR;
-          return FALSE;
-        }
-      det->present = atoi (g_strstrip (line + 4));
-    }
-  else if (g_str_has_prefix (line, "NO "))
-    {
-      /* Direct the evaluating code to process step ## next if the
-       * user does not have this key.
-       */
-      if (det->step_type != KEY_PRESENT_P &&
-          det->step_type != KEY_PRESENT)
-        {
-          *result = ERROR;
-          return FALSE;
-        }
-      det->not_present = atoi (g_strstrip (line + 3));
-    }
-  else if (g_str_has_prefix (line, "MAP "))
-    {
-      /* This step uniquely identifies a keymap. */
-      if (det->step_type == UNKNOWN)
-        det->step_type = RESULT;
-      det->result = g_strdup (g_strstrip (line + 4));
-      /* The Ubuntu file uses colons to separate country codes from layout
-       * variants, and GnomeXkb requires plus signs.
-       */
-      char *colon_pointer = strchr (det->result, ':');
-      if (colon_pointer != NULL)
-        *colon_pointer = '+';
-      *result = det->step_type;
-      return FALSE;
-    }
-  else
-    {
-      *result = ERROR;
-      return FALSE;
-    }
-  return TRUE;
+
+  g_variant_unref (symbols);
+  g_variant_unref (codes);
+
+  if (*result != '\0')
+    det->result = result;
+
+  /* Numbers that aren't steps of the tree are left UNKNOWN */
+  if (type == UNKNOWN)
+    return ERROR;
+
+  det->current_step = step;
+  det->step_type = type;
+
+  return det->step_type;
+}
+
+static gboolean
+is_next_step (KeyboardDetector *det,
+              int               step)
+{
+  GHashTableIter iter;
+  gpointer next_step;
+
+  if (step == det->present || step == det->not_present)
+    return TRUE;
+
+  g_hash_table_iter_init (&iter, det->keycodes);
+  while (g_hash_table_iter_next (&iter, NULL, &next_step))
+    if (GPOINTER_TO_INT (next_step) == step)
+      return TRUE;
+
+  return FALSE;
 }
 
 KeyboardDetectorStepType
 keyboard_detector_read_step (KeyboardDetector *det,
                              int               step)
 {
-  char *line;
-  size_t len;
-
   if (det->current_step != -1)
     {
-      GList *valid_steps = g_hash_table_get_values (det->keycodes);
-      gboolean found = (g_list_find (valid_steps, GINT_TO_POINTER (step)) != NULL);
-      g_list_free (valid_steps);
-      if (!(found || step == det->present || step == det->not_present))
+      if (!is_next_step (det, step))
         /* Invalid argument */
         return ERROR;
       if (det->result)
         /* Already done */
         return ERROR;
+
+      g_array_append_val (det->history, det->current_step);
     }
 
-  keyboard_detector_clear (det);
+  return load_step (det, step);
+}
+
+static gboolean
+result_matches (const char *result,
+                const char *layout)
+{
+  gsize len = strlen (layout);
+
+  return strncmp (result, layout, len) == 0 &&
+         (result[len] == '\0' || result[len] == '+');
+}
+
+/* Counts the results reachable from @step, and how many of them are
+ * variants of @layout.  The trees are DAGs, so @visited keeps shared
+ * subtrees from being counted twice.  If @parents is given, the step
+ * each one was first reached from goes in it. */
+static void
+count_results (KeyboardDetector *det,
+               int               step,
+               int               from,
+               const char       *layout,
+               guint8           *visited,
+               int              *parents,
+               guint            *total,
+               guint            *matching)
+{
+  GVariant *record, *codes;
+  guchar type;
+  int present, not_present;
+  const char *result;
+  gsize i, n;
+
+  if (step < 0 || (gsize) step >= g_variant_n_children (det->tree) || visited[step])
+    return;
+  visited[step] = TRUE;
+  if (parents != NULL)
+    parents[step] = from;
+
+  record = g_variant_get_child_value (det->tree, step);
+  g_variant_get (record, "(y*@a(ii)ii&s)", &type, NULL, &codes,
+                 &present, &not_present, &result);
+
+  if (type == RESULT)
+    {
+      *total += 1;
+      if (result_matches (result, layout))
+        *matching += 1;
+    }
+
+  n = g_variant_n_children (codes);
+  for (i = 0; i < n; i++)
+    {
+      int next_step;
 
-  while ((line = g_data_input_stream_read_line_utf8 (det->fp, &len, NULL, NULL)) != NULL)
+      g_variant_get_child (codes, i, "(ii)", NULL, &next_step);
+      count_results (det, next_step, step, layout, visited, parents, total, matching);
+    }
+  count_results (det, present, step, layout, visited, parents, total, matching);
+  count_results (det, not_present, step, layout, visited, parents, total, matching);
+
+  g_variant_unref (codes);
+  g_variant_unref (record);
+}
+
+/* Starts the detector at the smallest subtree which can still reach
+ * every variant of @layout, or at the top of the tree if @layout is
+ * %NULL or isn't in it.  The user then only has to tell apart the
+ * variants of a layout we already expect, rather than every layout.
+ * The steps leading there from the top go in the history, so going
+ * back still reaches every other layout when the hint is wrong. */
+KeyboardDetectorStepType
+keyboard_detector_start (KeyboardDetector *det,
+                         const char       *layout)
+{
+  gsize n_steps = g_variant_n_children (det->tree);
+  guint8 *reachable, *visited;
+  int *parents;
+  guint total, matching, wanted, best_total = G_MAXUINT;
+  int step, best_step = 0;
+
+  det->current_step = -1;
+  g_array_set_size (det->history, 0);
+
+  if (layout == NULL || n_steps == 0)
+    return load_step (det, 0);
+
+  reachable = g_new0 (guint8, n_steps);
+  visited = g_new0 (guint8, n_steps);
+  parents = g_new (int, n_steps);
+
+  total = wanted = 0;
+  count_results (det, 0, -1, layout, reachable, parents, &total, &wanted);
+
+  for (step = 0; wanted > 0 && (gsize) step < n_steps; step++)
     {
-      KeyboardDetectorStepType retval;
-      gboolean should_continue = process_line (det, step, line, &retval);
-      g_free (line);
-      if (!should_continue)
-        return retval;
+      if (!reachable[step])
+        continue;
+
+      memset (visited, 0, n_steps);
+      total = matching = 0;
+      count_results (det, step, -1, layout, visited, NULL, &total, &matching);
+      if (matching == wanted && total < best_total)
+        {
+          best_total = total;
+          best_step = step;
+        }
     }
 
-  /* The requested step was not found. */
-  return ERROR;
+  for (step = best_step; step != 0; step = parents[step])
+    g_array_prepend_val (det->history, parents[step]);
+
+  g_free (reachable);
+  g_free (visited);
+  g_free (parents);
+
+  g_debug ("Starting keyboard detector for %s at step %d", layout, best_step);
+
+  return load_step (det, best_step);
+}
+
+gboolean
+keyboard_detector_can_go_back (KeyboardDetector *det)
+{
+  return det->history->len > 0;
+}
+
+/* Returns to the step before the current one */
+KeyboardDetectorStepType
+keyboard_detector_go_back (KeyboardDetector *det)
+{
+  int step;
+
+  if (det->history->len == 0)
+    return ERROR;
+
+  step = g_array_index (det->history, int, det->history->len - 1);
+  g_array_set_size (det->history, det->history->len - 1);
+
+  return load_step (det, step);
 }
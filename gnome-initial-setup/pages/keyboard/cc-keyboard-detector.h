@@ -23,7 +23,6 @@
 #define CC_KEYBOARD_DETECTOR_H
 
 #include <glib.h>
-#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -36,23 +35,33 @@ typedef enum {
   ERROR,
 } KeyboardDetectorStepType;
 
+/* A compiled detector tree is an array of these, indexed by step:
+ * type, symbols, (keycode, step) pairs, present, not present, result.
+ * It is always stored little endian. */
+#define DETECTOR_STEP_TYPE "(yasa(ii)iis)"
+
 typedef struct {
   GHashTable *keycodes; /* GHashTable<int, int> */
   GList *symbols;       /* GList<char *>, strings owned by KeyboardDetector */
   int present;
   int not_present;
-  char *result;
+  const char *result;
 
   /* Private */
   int current_step;
   KeyboardDetectorStepType step_type;
-  GDataInputStream *fp;
+  GVariant *tree;
+  GArray *history;      /* of the steps taken to get to current_step */
 } KeyboardDetector;
 
-KeyboardDetector        *keyboard_detector_new       (void);
-void                     keyboard_detector_free      (KeyboardDetector *det);
-KeyboardDetectorStepType keyboard_detector_read_step (KeyboardDetector *det,
-                                                      int               step);
+KeyboardDetector        *keyboard_detector_new         (void);
+void                     keyboard_detector_free        (KeyboardDetector *det);
+KeyboardDetectorStepType keyboard_detector_read_step   (KeyboardDetector *det,
+                                                        int               step);
+KeyboardDetectorStepType keyboard_detector_start       (KeyboardDetector *det,
+                                                        const char       *layout);
+gboolean                 keyboard_detector_can_go_back (KeyboardDetector *det);
+KeyboardDetectorStepType keyboard_detector_go_back     (KeyboardDetector *det);
 
 G_END_DECLS
 
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gudev/gudev.h>
+
+#include "cc-keyboard-hints.h"
+
+/* udev sets XKB_FIXED_LAYOUT and XKB_FIXED_VARIANT on keyboards from
+ * hwdb, whose keyboard entries can match on the DMI or device tree
+ * modalias of the machine as well as on the device itself.  That is
+ * where the layout of the built-in keyboard of a known machine should
+ * be described.
+ */
+
+static gboolean
+is_built_in (GUdevDevice *device)
+{
+        const gchar *bus;
+
+        /* External keyboards with a fixed layout, such as security keys
+         * which type "us" characters, say nothing about the layout the
+         * user types on.
+         */
+        bus = g_udev_device_get_property (device, "ID_BUS");
+        return g_strcmp0 (bus, "usb") != 0 && g_strcmp0 (bus, "bluetooth") != 0;
+}
+
+static gchar *
+get_device_layout (GUdevDevice *device)
+{
+        const gchar *layout, *variant;
+        gchar *first_layout, *first_variant, *id;
+
+        if (!g_udev_device_get_property_as_boolean (device, "ID_INPUT_KEYBOARD"))
+                return NULL;
+
+        layout = g_udev_device_get_property (device, "XKB_FIXED_LAYOUT");
+        if (layout == NULL || *layout == '\0')
+                return NULL;
+
+        /* These are in the comma separated form of XKB_DEFAULT_LAYOUT;
+         * the first layout is the one printed on the keys.
+         */
+        first_layout = g_strndup (layout, strcspn (layout, ","));
+
+        variant = g_udev_device_get_property (device, "XKB_FIXED_VARIANT");
+        if (variant != NULL)
+                first_variant = g_strndup (variant, strcspn (variant, ","));
+        else
+                first_variant = NULL;
+
+        if (first_variant != NULL && *first_variant != '\0')
+                id = g_strdup_printf ("%s+%s", first_layout, first_variant);
+        else
+                id = g_strdup (first_layout);
+
+        g_free (first_layout);
+        g_free (first_variant);
+
+        return id;
+}
+
+static gchar *
+find_layout (void)
+{
+        const gchar * const subsystems[] = { "input", NULL };
+        GUdevClient *client;
+        GList *devices, *l;
+        gchar *id = NULL;
+
+        client = g_udev_client_new (subsystems);
+        devices = g_udev_client_query_by_subsystem (client, "input");
+
+        for (l = devices; l != NULL && id == NULL; l = l->next) {
+                GUdevDevice *device = l->data;
+
+                if (is_built_in (device))
+                        id = get_device_layout (device);
+        }
+
+        g_list_free_full (devices, g_object_unref);
+        g_object_unref (client);
+
+        if (id != NULL)
+                g_debug ("Built-in keyboard has layout %s", id);
+
+        return id;
+}
+
+/* Returns the layout of the built-in keyboard as an XKB input source
+ * id, or %NULL if the hardware doesn't tell us.  The devices are only
+ * queried once per process.
+ */
+const gchar *
+cc_keyboard_hints_get_layout (void)
+{
+        static gsize initialized = 0;
+        static gchar *layout = NULL;
+
+        if (g_once_init_enter (&initialized)) {
+                layout = find_layout ();
+                g_once_init_leave (&initialized, 1);
+        }
+
+        return layout;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CC_KEYBOARD_HINTS_H__
+#define __CC_KEYBOARD_HINTS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+const gchar *cc_keyboard_hints_get_layout (void);
+
+G_END_DECLS
+
+#endif /* __CC_KEYBOARD_HINTS_H__ */
@@ -0,0 +1,402 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Draws the main block of a pc105 keyboard with the symbols of a
+ * layout, as compiled by xkbcommon.  Both the keymaps and the drawn
+ * keyboards are kept for the life of the process, so showing a layout
+ * again is a single paint. */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <xkbcommon/xkbcommon.h>
+
+#include "cc-keyboard-preview.h"
+
+typedef struct
+{
+  char *layout;
+  char *variant;
+} CcKeyboardPreviewPrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (CcKeyboardPreview, cc_keyboard_preview, GTK_TYPE_DRAWING_AREA);
+
+/* Drawn keyboards, by layout, variant, size and scale */
+#define MAX_SURFACES 32
+
+/* Widths are in quarters of a normal key */
+typedef struct
+{
+  xkb_keycode_t keycode;
+  int width;
+} Key;
+
+#define ROW_WIDTH 60
+#define N_ROWS 5
+
+/* X keycodes, that is evdev codes + 8 */
+static const Key row0[] = {
+  { 49, 4 }, { 10, 4 }, { 11, 4 }, { 12, 4 }, { 13, 4 }, { 14, 4 }, { 15, 4 },
+  { 16, 4 }, { 17, 4 }, { 18, 4 }, { 19, 4 }, { 20, 4 }, { 21, 4 }, { 22, 8 },
+  { 0 }
+};
+static const Key row1[] = {
+  { 23, 6 }, { 24, 4 }, { 25, 4 }, { 26, 4 }, { 27, 4 }, { 28, 4 }, { 29, 4 },
+  { 30, 4 }, { 31, 4 }, { 32, 4 }, { 33, 4 }, { 34, 4 }, { 35, 4 }, { 51, 6 },
+  { 0 }
+};
+static const Key row2[] = {
+  { 66, 7 }, { 38, 4 }, { 39, 4 }, { 40, 4 }, { 41, 4 }, { 42, 4 }, { 43, 4 },
+  { 44, 4 }, { 45, 4 }, { 46, 4 }, { 47, 4 }, { 48, 4 }, { 36, 9 },
+  { 0 }
+};
+static const Key row3[] = {
+  { 50, 5 }, { 94, 4 }, { 52, 4 }, { 53, 4 }, { 54, 4 }, { 55, 4 }, { 56, 4 },
+  { 57, 4 }, { 58, 4 }, { 59, 4 }, { 60, 4 }, { 61, 4 }, { 62, 11 },
+  { 0 }
+};
+static const Key row4[] = {
+  { 37, 5 }, { 133, 5 }, { 64, 5 }, { 65, 25 }, { 108, 5 }, { 134, 5 },
+  { 135, 5 }, { 105, 5 },
+  { 0 }
+};
+static const Key *rows[N_ROWS] = { row0, row1, row2, row3, row4 };
+
+static struct xkb_context *xkb_context = NULL;
+static GHashTable *keymaps = NULL;
+static GHashTable *surfaces = NULL;
+
+static struct xkb_keymap *
+get_keymap (const char *layout,
+            const char *variant)
+{
+  struct xkb_rule_names names = { 0 };
+  struct xkb_keymap *keymap;
+  char *key;
+
+  if (keymaps == NULL)
+    keymaps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                     (GDestroyNotify) xkb_keymap_unref);
+
+  key = g_strdup_printf ("%s\t%s", layout, variant);
+  if (g_hash_table_lookup_extended (keymaps, key, NULL, (gpointer *) &keymap))
+    {
+      g_free (key);
+      return keymap;
+    }
+
+  if (xkb_context == NULL)
+    xkb_context = xkb_context_new (XKB_CONTEXT_NO_FLAGS);
+
+  names.rules = "evdev";
+  names.model = "pc105";
+  names.layout = layout;
+  names.variant = variant;
+
+  keymap = NULL;
+  if (xkb_context != NULL)
+    keymap = xkb_keymap_new_from_names (xkb_context, &names,
+                                        XKB_KEYMAP_COMPILE_NO_FLAGS);
+  if (keymap == NULL)
+    g_warning ("Could not compile keymap for %s", key);
+
+  /* Failures are remembered too */
+  g_hash_table_insert (keymaps, key, keymap);
+
+  return keymap;
+}
+
+static const struct {
+  xkb_keysym_t keysym;
+  const char *label;
+} dead_keys[] = {
+  { XKB_KEY_dead_grave, "`" },
+  { XKB_KEY_dead_acute, "´" },
+  { XKB_KEY_dead_circumflex, "^" },
+  { XKB_KEY_dead_tilde, "~" },
+  { XKB_KEY_dead_macron, "¯" },
+  { XKB_KEY_dead_breve, "˘" },
+  { XKB_KEY_dead_abovedot, "˙" },
+  { XKB_KEY_dead_diaeresis, "¨" },
+  { XKB_KEY_dead_abovering, "˚" },
+  { XKB_KEY_dead_doubleacute, "˝" },
+  { XKB_KEY_dead_caron, "ˇ" },
+  { XKB_KEY_dead_cedilla, "¸" },
+  { XKB_KEY_dead_ogonek, "˛" },
+};
+
+/* Returns FALSE for keys which don't produce a visible symbol */
+static gboolean
+get_label (struct xkb_keymap *keymap,
+           xkb_keycode_t      keycode,
+           xkb_level_index_t  level,
+           char              *buffer,
+           gsize              size)
+{
+  const xkb_keysym_t *syms;
+  guint i;
+
+  buffer[0] = '\0';
+
+  if (keymap == NULL ||
+      xkb_keymap_key_get_syms_by_level (keymap, keycode, 0, level, &syms) < 1)
+    return FALSE;
+
+  for (i = 0; i < G_N_ELEMENTS (dead_keys); i++)
+    if (syms[0] == dead_keys[i].keysym)
+      {
+        g_strlcpy (buffer, dead_keys[i].label, size);
+        return TRUE;
+      }
+
+  if (xkb_keysym_to_utf8 (syms[0], buffer, size) <= 0 ||
+      !g_unichar_isgraph (g_utf8_get_char (buffer)))
+    {
+      buffer[0] = '\0';
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+draw_label (cairo_t       *cr,
+            PangoLayout   *layout,
+            const char    *text,
+            double         x,
+            double         y,
+            const GdkRGBA *color,
+            double         alpha)
+{
+  pango_layout_set_text (layout, text, -1);
+  cairo_set_source_rgba (cr, color->red, color->green, color->blue,
+                         color->alpha * alpha);
+  cairo_move_to (cr, x, y);
+  pango_cairo_show_layout (cr, layout);
+}
+
+static void
+draw_key (cairo_t           *cr,
+          PangoLayout       *layout,
+          struct xkb_keymap *keymap,
+          const Key         *key,
+          double             x,
+          double             y,
+          double             width,
+          double             height,
+          const GdkRGBA     *color)
+{
+  char base[8], shifted[8], alt[8];
+  gboolean has_base, has_shifted, has_alt;
+  double pad = height / 8;
+  int text_height;
+
+  cairo_new_sub_path (cr);
+  cairo_arc (cr, x + width - pad, y + pad, pad, -G_PI / 2, 0);
+  cairo_arc (cr, x + width - pad, y + height - pad, pad, 0, G_PI / 2);
+  cairo_arc (cr, x + pad, y + height - pad, pad, G_PI / 2, G_PI);
+  cairo_arc (cr, x + pad, y + pad, pad, G_PI, 3 * G_PI / 2);
+  cairo_close_path (cr);
+
+  cairo_set_source_rgba (cr, color->red, color->green, color->blue, 0.08);
+  cairo_fill_preserve (cr);
+  cairo_set_source_rgba (cr, color->red, color->green, color->blue, 0.4);
+  cairo_set_line_width (cr, 1);
+  cairo_stroke (cr);
+
+  has_base = get_label (keymap, key->keycode, 0, base, sizeof base);
+  has_shifted = get_label (keymap, key->keycode, 1, shifted, sizeof shifted);
+  has_alt = get_label (keymap, key->keycode, 2, alt, sizeof alt);
+
+  /* Letters are only printed in upper case, like on the keys */
+  if (has_base && has_shifted &&
+      g_unichar_toupper (g_utf8_get_char (base)) == g_utf8_get_char (shifted))
+    has_base = FALSE;
+
+  pango_layout_set_text (layout, "", -1);
+  pango_layout_get_pixel_size (layout, NULL, &text_height);
+
+  if (has_shifted)
+    draw_label (cr, layout, shifted, x + pad, y + pad / 2, color, 1.0);
+  if (has_base)
+    draw_label (cr, layout, base, x + pad, y + height - pad / 2 - text_height, color, 1.0);
+  /* The AltGr symbol, when it is not just a repeat */
+  if (has_alt && strcmp (alt, base) != 0 && strcmp (alt, shifted) != 0)
+    draw_label (cr, layout, alt, x + width / 2, y + height - pad / 2 - text_height, color, 0.6);
+}
+
+static cairo_surface_t *
+draw_keyboard (CcKeyboardPreview *self,
+               int                width,
+               int                height)
+{
+  CcKeyboardPreviewPrivate *priv = cc_keyboard_preview_get_instance_private (self);
+  GtkWidget *widget = GTK_WIDGET (self);
+  struct xkb_keymap *keymap;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  PangoLayout *layout;
+  PangoFontDescription *font;
+  GdkRGBA color;
+  double unit, key_height, x0, y0;
+  int row;
+
+  keymap = get_keymap (priv->layout, priv->variant ? priv->variant : "");
+
+  surface = gdk_window_create_similar_image_surface (gtk_widget_get_window (widget),
+                                                     CAIRO_FORMAT_ARGB32,
+                                                     width, height,
+                                                     gtk_widget_get_scale_factor (widget));
+  cr = cairo_create (surface);
+
+  unit = MIN ((double) width / ROW_WIDTH, (double) height / (N_ROWS * 4));
+  key_height = unit * 4;
+  x0 = (width - unit * ROW_WIDTH) / 2;
+  y0 = (height - key_height * N_ROWS) / 2;
+
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget),
+                               gtk_widget_get_state_flags (widget), &color);
+
+  layout = gtk_widget_create_pango_layout (widget, NULL);
+  font = pango_font_description_copy (pango_context_get_font_description (pango_layout_get_context (layout)));
+  pango_font_description_set_absolute_size (font, key_height / 3 * PANGO_SCALE);
+  pango_layout_set_font_description (layout, font);
+  pango_font_description_free (font);
+
+  for (row = 0; row < N_ROWS; row++)
+    {
+      const Key *key;
+      double x = x0;
+
+      for (key = rows[row]; key->keycode != 0; key++)
+        {
+          draw_key (cr, layout, keymap, key,
+                    x + 1, y0 + row * key_height + 1,
+                    key->width * unit - 2, key_height - 2, &color);
+          x += key->width * unit;
+        }
+    }
+
+  g_object_unref (layout);
+  cairo_destroy (cr);
+
+  return surface;
+}
+
+static cairo_surface_t *
+get_surface (CcKeyboardPreview *self,
+             int                width,
+             int                height)
+{
+  CcKeyboardPreviewPrivate *priv = cc_keyboard_preview_get_instance_private (self);
+  cairo_surface_t *surface;
+  char *key;
+
+  if (surfaces == NULL)
+    surfaces = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify) cairo_surface_destroy);
+
+  key = g_strdup_printf ("%s\t%s\t%dx%d@%d", priv->layout,
+                         priv->variant ? priv->variant : "", width, height,
+                         gtk_widget_get_scale_factor (GTK_WIDGET (self)));
+  surface = g_hash_table_lookup (surfaces, key);
+  if (surface != NULL)
+    {
+      g_free (key);
+      return surface;
+    }
+
+  if (g_hash_table_size (surfaces) >= MAX_SURFACES)
+    g_hash_table_remove_all (surfaces);
+
+  surface = draw_keyboard (self, width, height);
+  g_hash_table_insert (surfaces, key, surface);
+
+  return surface;
+}
+
+static gboolean
+cc_keyboard_preview_draw (GtkWidget *widget,
+                          cairo_t   *cr)
+{
+  CcKeyboardPreview *self = CC_KEYBOARD_PREVIEW (widget);
+  CcKeyboardPreviewPrivate *priv = cc_keyboard_preview_get_instance_private (self);
+  int width, height;
+
+  if (priv->layout == NULL)
+    return GDK_EVENT_PROPAGATE;
+
+  width = gtk_widget_get_allocated_width (widget);
+  height = gtk_widget_get_allocated_height (widget);
+
+  cairo_set_source_surface (cr, get_surface (self, width, height), 0, 0);
+  cairo_paint (cr);
+
+  return GDK_EVENT_PROPAGATE;
+}
+
+static void
+cc_keyboard_preview_finalize (GObject *object)
+{
+  CcKeyboardPreview *self = CC_KEYBOARD_PREVIEW (object);
+  CcKeyboardPreviewPrivate *priv = cc_keyboard_preview_get_instance_private (self);
+
+  g_free (priv->layout);
+  g_free (priv->variant);
+
+  G_OBJECT_CLASS (cc_keyboard_preview_parent_class)->finalize (object);
+}
+
+static void
+cc_keyboard_preview_class_init (CcKeyboardPreviewClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->finalize = cc_keyboard_preview_finalize;
+  widget_class->draw = cc_keyboard_preview_draw;
+}
+
+static void
+cc_keyboard_preview_init (CcKeyboardPreview *self)
+{
+  gtk_widget_set_size_request (GTK_WIDGET (self), 600, 200);
+}
+
+GtkWidget *
+cc_keyboard_preview_new (void)
+{
+  return g_object_new (CC_TYPE_KEYBOARD_PREVIEW, NULL);
+}
+
+void
+cc_keyboard_preview_set_layout (CcKeyboardPreview *self,
+                                const char        *layout,
+                                const char        *variant)
+{
+  CcKeyboardPreviewPrivate *priv = cc_keyboard_preview_get_instance_private (self);
+
+  g_free (priv->layout);
+  g_free (priv->variant);
+  priv->layout = g_strdup (layout);
+  priv->variant = g_strdup (variant);
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
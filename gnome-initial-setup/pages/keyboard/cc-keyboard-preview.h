@@ -0,0 +1,56 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CC_KEYBOARD_PREVIEW_H
+#define CC_KEYBOARD_PREVIEW_H
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define CC_TYPE_KEYBOARD_PREVIEW cc_keyboard_preview_get_type()
+#define CC_KEYBOARD_PREVIEW(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), CC_TYPE_KEYBOARD_PREVIEW, CcKeyboardPreview))
+#define CC_KEYBOARD_PREVIEW_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass), CC_TYPE_KEYBOARD_PREVIEW, CcKeyboardPreviewClass))
+#define CC_IS_KEYBOARD_PREVIEW(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CC_TYPE_KEYBOARD_PREVIEW))
+#define CC_IS_KEYBOARD_PREVIEW_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), CC_TYPE_KEYBOARD_PREVIEW))
+#define CC_KEYBOARD_PREVIEW_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), CC_TYPE_KEYBOARD_PREVIEW, CcKeyboardPreviewClass))
+
+typedef struct _CcKeyboardPreview CcKeyboardPreview;
+typedef struct _CcKeyboardPreviewClass CcKeyboardPreviewClass;
+
+struct _CcKeyboardPreview
+{
+  GtkDrawingArea parent;
+};
+
+struct _CcKeyboardPreviewClass
+{
+  GtkDrawingAreaClass parent_class;
+};
+
+GType      cc_keyboard_preview_get_type   (void) G_GNUC_CONST;
+GtkWidget *cc_keyboard_preview_new        (void);
+void       cc_keyboard_preview_set_layout (CcKeyboardPreview *self,
+                                           const char        *layout,
+                                           const char        *variant);
+
+G_END_DECLS
+
+#endif /* CC_KEYBOARD_PREVIEW_H */
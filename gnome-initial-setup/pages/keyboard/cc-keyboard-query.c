@@ -20,11 +20,14 @@
  */
 
 #include <config.h>
+#include <string.h>
 #include <glib/gi18n.h>
 
 #include "cc-keyboard-detector.h"
+#include "cc-keyboard-hints.h"
 #include "cc-keyboard-query.h"
 #include "cc-key-row.h"
+#include "cc-xkb-cache.h"
 
 typedef struct
 {
@@ -39,9 +42,10 @@ typedef struct
   GtkWidget *heading;
   GtkWidget *keyrow;
   GtkWidget *buttons;
+  GtkWidget *back_button;
   GtkWidget *select_button;
 
-  GnomeXkbInfo *xkb_data;
+  CcXkbCache *xkb_data;
 } CcKeyboardQueryPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (CcKeyboardQuery, cc_keyboard_query, GTK_TYPE_DIALOG);
@@ -85,6 +89,10 @@ process (CcKeyboardQuery         *self,
     default:
       g_assert_not_reached ();
     }
+
+  gtk_widget_set_visible (priv->back_button,
+                          result != ERROR &&
+                          keyboard_detector_can_go_back (priv->det));
 }
 
 static void
@@ -109,6 +117,23 @@ no_have_key (GtkButton       *button,
   process (self, result);
 }
 
+static void
+go_back (GtkButton       *button,
+         CcKeyboardQuery *self)
+{
+  CcKeyboardQueryPrivate *priv = cc_keyboard_query_get_instance_private (self);
+  KeyboardDetectorStepType result;
+
+  /* Undo what a result did to the dialog */
+  g_clear_pointer (&priv->detected_id, g_free);
+  g_clear_pointer (&priv->detected_display_name, g_free);
+  gtk_widget_show (priv->keyrow);
+  gtk_widget_set_sensitive (priv->select_button, FALSE);
+
+  result = keyboard_detector_go_back (priv->det);
+  process (self, result);
+}
+
 static gboolean
 key_press_event (GtkWidget       *widget,
                  GdkEventKey     *event,
@@ -162,7 +187,7 @@ cc_keyboard_query_finalize (GObject *object)
   CcKeyboardQuery *self = CC_KEYBOARD_QUERY (object);
   CcKeyboardQueryPrivate *priv = cc_keyboard_query_get_instance_private (self);
 
-  g_clear_object (&priv->xkb_data);
+  g_clear_pointer (&priv->xkb_data, cc_xkb_cache_unref);
 
   g_clear_pointer (&priv->det, keyboard_detector_free);
   g_clear_pointer (&priv->detected_id, g_free);
@@ -182,8 +207,8 @@ cc_keyboard_query_layout_result (CcKeyboardQuery *self,
 
   priv->detected_id = g_strdup (result);
 
-  gnome_xkb_info_get_layout_info (priv->xkb_data, result, &display_name, NULL,
-                                  NULL, NULL);
+  cc_xkb_cache_get_layout_info (priv->xkb_data, result, &display_name, NULL,
+                                NULL, NULL);
 
   priv->detected_display_name = g_strdup (display_name);
   result_message = g_strdup_printf ("%s\n%s",
@@ -283,9 +308,11 @@ cc_keyboard_query_class_init (CcKeyboardQueryClass *klass)
   gtk_widget_class_bind_template_child_private (widget_class, CcKeyboardQuery, vbox);
   gtk_widget_class_bind_template_child_private (widget_class, CcKeyboardQuery, heading);
   gtk_widget_class_bind_template_child_private (widget_class, CcKeyboardQuery, buttons);
+  gtk_widget_class_bind_template_child_private (widget_class, CcKeyboardQuery, back_button);
   gtk_widget_class_bind_template_child_private (widget_class, CcKeyboardQuery, select_button);
   gtk_widget_class_bind_template_callback (widget_class, have_key);
   gtk_widget_class_bind_template_callback (widget_class, no_have_key);
+  gtk_widget_class_bind_template_callback (widget_class, go_back);
   gtk_widget_class_bind_template_callback (widget_class, key_press_event);
 
   widget_class->realize = cc_keyboard_query_realize;
@@ -305,7 +332,7 @@ cc_keyboard_query_init (CcKeyboardQuery *self)
   priv->present_string = _("Is the following key present on your keyboard?");
 
   priv->det = keyboard_detector_new ();
-  priv->xkb_data = gnome_xkb_info_new ();
+  priv->xkb_data = cc_xkb_cache_get_default ();
 }
 
 GtkWidget *
@@ -322,10 +349,20 @@ cc_keyboard_query_run (CcKeyboardQuery *self)
 {
   CcKeyboardQueryPrivate *priv = cc_keyboard_query_get_instance_private (self);
   KeyboardDetectorStepType result;
+  const gchar *hint;
+  gchar *layout = NULL;
+
+  /* With a hint from the hardware we only need to tell apart the
+   * variants of the hinted layout */
+  hint = cc_keyboard_hints_get_layout ();
+  if (hint != NULL)
+    layout = g_strndup (hint, strcspn (hint, "+"));
 
   gtk_widget_show_all (GTK_WIDGET (self));
-  result = keyboard_detector_read_step (priv->det, 0);
+  result = keyboard_detector_start (priv->det, layout);
   process (self, result);
+
+  g_free (layout);
 }
 
 gboolean
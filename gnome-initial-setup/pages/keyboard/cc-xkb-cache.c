@@ -0,0 +1,477 @@
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The parts of GnomeXkbInfo the keyboard page uses, kept in a GVariant
+ * file in the user cache so that the XML rules don't have to be parsed
+ * again.  The file is mapped, and the dictionaries in it are sorted by
+ * key so that a lookup is a binary search over the mapped data.
+ *
+ * The layouts for a language or country are only recorded for those
+ * of the installed locales; other codes are answered by a GnomeXkbInfo
+ * which is only created when needed.
+ */
+
+#include <config.h>
+
+#include <locale.h>
+#include <string.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#define GNOME_DESKTOP_USE_UNSTABLE_API
+#include <libgnome-desktop/gnome-languages.h>
+#include <libgnome-desktop/gnome-xkb-info.h>
+
+#include "cc-common-language.h"
+#include "cc-xkb-cache.h"
+
+/* Key, layout id to (display name, short name, layout, variant),
+ * language code to layout ids, country code to layout ids */
+#define CACHE_TYPE "(sa{s(ssss)}a{sas}a{sas})"
+
+struct _CcXkbCache
+{
+        gint ref_count;
+        gchar *locale;
+
+        GVariant *data;
+        GVariant *layouts;
+        GVariant *languages;
+        GVariant *countries;
+
+        GnomeXkbInfo *fallback;
+};
+
+static CcXkbCache *default_cache = NULL;
+
+static gchar *
+get_cache_path (void)
+{
+        return g_build_filename (g_get_user_cache_dir (),
+                                 "gnome-initial-setup",
+                                 "xkb-layouts",
+                                 NULL);
+}
+
+/* The names are translated when the rules are parsed, and the extra
+ * layouts are only listed when the user asked for all of them */
+static gchar *
+get_cache_key (const gchar *locale)
+{
+        const gchar *files[] = {
+                XKB_BASE "/rules/evdev.xml",
+                XKB_BASE "/rules/evdev.extras.xml",
+        };
+        GSettingsSchema *schema;
+        gboolean show_all = FALSE;
+        GString *key;
+        guint i;
+
+        schema = g_settings_schema_source_lookup (g_settings_schema_source_get_default (),
+                                                  "org.gnome.desktop.input-sources",
+                                                  TRUE);
+        if (schema != NULL) {
+                GSettings *settings = g_settings_new ("org.gnome.desktop.input-sources");
+
+                show_all = g_settings_get_boolean (settings, "show-all-sources");
+                g_object_unref (settings);
+                g_settings_schema_unref (schema);
+        }
+
+        key = g_string_new (PACKAGE_VERSION);
+        g_string_append_printf (key, ";%s;%d", locale, show_all);
+        for (i = 0; i < G_N_ELEMENTS (files); i++) {
+                GStatBuf buf;
+
+                if (g_stat (files[i], &buf) == 0)
+                        g_string_append_printf (key, ";%" G_GINT64_FORMAT, (gint64) buf.st_mtime);
+        }
+
+        return g_string_free (key, FALSE);
+}
+
+static GVariant *
+load_data (const gchar *path,
+           const gchar *key)
+{
+        GMappedFile *file;
+        GBytes *bytes;
+        GVariant *data;
+        const gchar *cached_key;
+
+        file = g_mapped_file_new (path, FALSE, NULL);
+        if (file == NULL)
+                return NULL;
+
+        bytes = g_mapped_file_get_bytes (file);
+        g_mapped_file_unref (file);
+
+        data = g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_TYPE), bytes, FALSE);
+        g_variant_ref_sink (data);
+        g_bytes_unref (bytes);
+
+        g_variant_get_child (data, 0, "&s", &cached_key);
+        if (g_strcmp0 (cached_key, key) != 0)
+                g_clear_pointer (&data, g_variant_unref);
+
+        return data;
+}
+
+static void
+save_data (const gchar *path,
+           GVariant    *data)
+{
+        GError *error = NULL;
+        gchar *dir;
+
+        dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (dir, 0755);
+        g_free (dir);
+
+        if (!g_file_set_contents (path,
+                                  g_variant_get_data (data),
+                                  g_variant_get_size (data),
+                                  &error)) {
+                g_debug ("Could not save XKB layout cache: %s", error->message);
+                g_error_free (error);
+        }
+}
+
+static GVariant *
+build_id_list (GList *ids)
+{
+        GVariantBuilder builder;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE_STRING_ARRAY);
+        for (; ids != NULL; ids = ids->next)
+                g_variant_builder_add (&builder, "s", ids->data);
+
+        return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+build_data (GnomeXkbInfo *info,
+            const gchar  *key)
+{
+        GVariantBuilder layouts, languages, countries;
+        GHashTable *language_codes, *country_codes;
+        GList *ids, *codes, *l;
+        gchar **locales;
+        GVariant *data;
+        guint i;
+
+        g_variant_builder_init (&layouts, G_VARIANT_TYPE ("a{s(ssss)}"));
+        ids = g_list_sort (gnome_xkb_info_get_all_layouts (info), (GCompareFunc) strcmp);
+        for (l = ids; l != NULL; l = l->next) {
+                const gchar *display_name = NULL, *short_name = NULL;
+                const gchar *xkb_layout = NULL, *xkb_variant = NULL;
+
+                gnome_xkb_info_get_layout_info (info, l->data,
+                                                &display_name, &short_name,
+                                                &xkb_layout, &xkb_variant);
+                g_variant_builder_add (&layouts, "{s(ssss)}", l->data,
+                                       display_name ? display_name : "",
+                                       short_name ? short_name : "",
+                                       xkb_layout ? xkb_layout : "",
+                                       xkb_variant ? xkb_variant : "");
+        }
+        g_list_free (ids);
+
+        language_codes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        country_codes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        locales = cc_common_language_get_all_locales ();
+        for (i = 0; locales[i] != NULL; i++) {
+                gchar *language_code = NULL, *country_code = NULL;
+
+                if (!gnome_parse_locale (locales[i], &language_code, &country_code, NULL, NULL)) {
+                        g_free (language_code);
+                        g_free (country_code);
+                        continue;
+                }
+
+                g_hash_table_add (language_codes, language_code);
+                if (country_code != NULL)
+                        g_hash_table_add (country_codes, country_code);
+        }
+        g_strfreev (locales);
+
+        g_variant_builder_init (&languages, G_VARIANT_TYPE ("a{sas}"));
+        codes = g_list_sort (g_hash_table_get_keys (language_codes), (GCompareFunc) strcmp);
+        for (l = codes; l != NULL; l = l->next) {
+                ids = gnome_xkb_info_get_layouts_for_language (info, l->data);
+                g_variant_builder_add (&languages, "{s@as}", l->data, build_id_list (ids));
+                g_list_free (ids);
+        }
+        g_list_free (codes);
+
+        g_variant_builder_init (&countries, G_VARIANT_TYPE ("a{sas}"));
+        codes = g_list_sort (g_hash_table_get_keys (country_codes), (GCompareFunc) strcmp);
+        for (l = codes; l != NULL; l = l->next) {
+                ids = gnome_xkb_info_get_layouts_for_country (info, l->data);
+                g_variant_builder_add (&countries, "{s@as}", l->data, build_id_list (ids));
+                g_list_free (ids);
+        }
+        g_list_free (codes);
+
+        g_hash_table_destroy (language_codes);
+        g_hash_table_destroy (country_codes);
+
+        data = g_variant_new ("(sa{s(ssss)}a{sas}a{sas})", key,
+                              &layouts, &languages, &countries);
+
+        return g_variant_ref_sink (data);
+}
+
+static CcXkbCache *
+cc_xkb_cache_new (const gchar *locale)
+{
+        CcXkbCache *cache;
+        gchar *path, *key;
+
+        cache = g_new0 (CcXkbCache, 1);
+        cache->ref_count = 1;
+        cache->locale = g_strdup (locale);
+
+        path = get_cache_path ();
+        key = get_cache_key (locale);
+
+        cache->data = load_data (path, key);
+        if (cache->data == NULL) {
+                GVariant *data;
+
+                cache->fallback = gnome_xkb_info_new ();
+                data = build_data (cache->fallback, key);
+                cache->data = g_variant_get_normal_form (data);
+                g_variant_unref (data);
+
+                save_data (path, cache->data);
+        }
+
+        cache->layouts = g_variant_get_child_value (cache->data, 1);
+        cache->languages = g_variant_get_child_value (cache->data, 2);
+        cache->countries = g_variant_get_child_value (cache->data, 3);
+
+        g_free (key);
+        g_free (path);
+
+        return cache;
+}
+
+/**
+ * cc_xkb_cache_get_default:
+ *
+ * Returns: (transfer full): the cache for the current language,
+ * shared by all callers
+ */
+CcXkbCache *
+cc_xkb_cache_get_default (void)
+{
+        const gchar *locale;
+
+        locale = setlocale (LC_MESSAGES, NULL);
+        if (default_cache != NULL && g_strcmp0 (default_cache->locale, locale) == 0)
+                return cc_xkb_cache_ref (default_cache);
+
+        g_clear_pointer (&default_cache, cc_xkb_cache_unref);
+        default_cache = cc_xkb_cache_new (locale);
+
+        return cc_xkb_cache_ref (default_cache);
+}
+
+CcXkbCache *
+cc_xkb_cache_ref (CcXkbCache *cache)
+{
+        cache->ref_count++;
+
+        return cache;
+}
+
+void
+cc_xkb_cache_unref (CcXkbCache *cache)
+{
+        if (--cache->ref_count > 0)
+                return;
+
+        g_variant_unref (cache->layouts);
+        g_variant_unref (cache->languages);
+        g_variant_unref (cache->countries);
+        g_variant_unref (cache->data);
+        g_clear_object (&cache->fallback);
+        g_free (cache->locale);
+
+        g_free (cache);
+}
+
+static GnomeXkbInfo *
+get_fallback (CcXkbCache *cache)
+{
+        if (cache->fallback == NULL)
+                cache->fallback = gnome_xkb_info_new ();
+
+        return cache->fallback;
+}
+
+/* Returns the value for @key in the sorted dictionary @dict */
+static GVariant *
+lookup_sorted (GVariant    *dict,
+               const gchar *key)
+{
+        gsize low = 0, high = g_variant_n_children (dict);
+
+        while (low < high) {
+                gsize mid = low + (high - low) / 2;
+                GVariant *entry, *value;
+                const gchar *entry_key;
+                gint cmp;
+
+                entry = g_variant_get_child_value (dict, mid);
+                g_variant_get (entry, "{&s@*}", &entry_key, &value);
+                g_variant_unref (entry);
+
+                cmp = strcmp (entry_key, key);
+                if (cmp == 0)
+                        return value;
+
+                g_variant_unref (value);
+                if (cmp < 0)
+                        low = mid + 1;
+                else
+                        high = mid;
+        }
+
+        return NULL;
+}
+
+static GList *
+get_id_list (GVariant *ids)
+{
+        GList *list = NULL;
+        gsize i, n;
+
+        n = g_variant_n_children (ids);
+        for (i = n; i > 0; i--) {
+                const gchar *id;
+
+                g_variant_get_child (ids, i - 1, "&s", &id);
+                list = g_list_prepend (list, (gpointer) id);
+        }
+
+        return list;
+}
+
+/**
+ * cc_xkb_cache_get_all_layouts:
+ *
+ * Returns: (transfer container): the layout ids, which belong to @cache
+ */
+GList *
+cc_xkb_cache_get_all_layouts (CcXkbCache *cache)
+{
+        GList *list = NULL;
+        gsize i, n;
+
+        n = g_variant_n_children (cache->layouts);
+        for (i = n; i > 0; i--) {
+                const gchar *id;
+
+                g_variant_get_child (cache->layouts, i - 1, "{&s*}", &id, NULL);
+                list = g_list_prepend (list, (gpointer) id);
+        }
+
+        return list;
+}
+
+/**
+ * cc_xkb_cache_get_layouts_for_language:
+ *
+ * Like gnome_xkb_info_get_layouts_for_language().
+ *
+ * Returns: (transfer container): the layout ids, which belong to @cache
+ */
+GList *
+cc_xkb_cache_get_layouts_for_language (CcXkbCache  *cache,
+                                       const gchar *language_code)
+{
+        GVariant *ids;
+        GList *list;
+
+        ids = lookup_sorted (cache->languages, language_code);
+        if (ids == NULL)
+                return gnome_xkb_info_get_layouts_for_language (get_fallback (cache),
+                                                                language_code);
+
+        list = get_id_list (ids);
+        g_variant_unref (ids);
+
+        return list;
+}
+
+/**
+ * cc_xkb_cache_get_layouts_for_country:
+ *
+ * Like gnome_xkb_info_get_layouts_for_country().
+ *
+ * Returns: (transfer container): the layout ids, which belong to @cache
+ */
+GList *
+cc_xkb_cache_get_layouts_for_country (CcXkbCache  *cache,
+                                      const gchar *country_code)
+{
+        GVariant *ids;
+        GList *list;
+
+        ids = lookup_sorted (cache->countries, country_code);
+        if (ids == NULL)
+                return gnome_xkb_info_get_layouts_for_country (get_fallback (cache),
+                                                               country_code);
+
+        list = get_id_list (ids);
+        g_variant_unref (ids);
+
+        return list;
+}
+
+/**
+ * cc_xkb_cache_get_layout_info:
+ *
+ * Like gnome_xkb_info_get_layout_info(); any of the out arguments
+ * may be %NULL.
+ *
+ * Returns: %TRUE if @id is a known layout
+ */
+gboolean
+cc_xkb_cache_get_layout_info (CcXkbCache   *cache,
+                              const gchar  *id,
+                              const gchar **display_name,
+                              const gchar **short_name,
+                              const gchar **xkb_layout,
+                              const gchar **xkb_variant)
+{
+        GVariant *info;
+
+        info = lookup_sorted (cache->layouts, id);
+        if (info == NULL)
+                return FALSE;
+
+        g_variant_get (info, "(&s&s&s&s)",
+                       display_name, short_name, xkb_layout, xkb_variant);
+        g_variant_unref (info);
+
+        return TRUE;
+}
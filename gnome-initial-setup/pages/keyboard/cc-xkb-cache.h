@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CC_XKB_CACHE_H__
+#define __CC_XKB_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _CcXkbCache CcXkbCache;
+
+CcXkbCache *cc_xkb_cache_get_default              (void);
+CcXkbCache *cc_xkb_cache_ref                      (CcXkbCache   *cache);
+void        cc_xkb_cache_unref                    (CcXkbCache   *cache);
+
+GList      *cc_xkb_cache_get_all_layouts          (CcXkbCache   *cache);
+GList      *cc_xkb_cache_get_layouts_for_language (CcXkbCache   *cache,
+                                                   const gchar  *language_code);
+GList      *cc_xkb_cache_get_layouts_for_country  (CcXkbCache   *cache,
+                                                   const gchar  *country_code);
+gboolean    cc_xkb_cache_get_layout_info          (CcXkbCache   *cache,
+                                                   const gchar  *id,
+                                                   const gchar **display_name,
+                                                   const gchar **short_name,
+                                                   const gchar **xkb_layout,
+                                                   const gchar **xkb_variant);
+
+G_END_DECLS
+
+#endif /* __CC_XKB_CACHE_H__ */
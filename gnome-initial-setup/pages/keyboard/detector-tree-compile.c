@@ -0,0 +1,289 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Build-time helper which compiles a keyboard detector tree into the
+ * GVariant form read by KeyboardDetector: an array indexed by step
+ * number, of DETECTOR_STEP_TYPE records.  Numbers which aren't steps
+ * of the tree get a record of type UNKNOWN.  The output is little
+ * endian whatever the build machine is.
+ *
+ *   detector-tree-compile INPUT OUTPUT
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "cc-keyboard-detector.h"
+
+typedef struct {
+  KeyboardDetectorStepType type;
+  GPtrArray *symbols;
+  GArray *codes;                /* of (keycode, step) pairs */
+  int present;
+  int not_present;
+  char *result;
+} Step;
+
+static void
+step_free (gpointer data)
+{
+  Step *step = data;
+
+  if (step == NULL)
+    return;
+
+  g_ptr_array_unref (step->symbols);
+  g_array_unref (step->codes);
+  g_free (step->result);
+  g_free (step);
+}
+
+static gboolean
+parse_int (const char *str,
+           int        *value)
+{
+  char *end;
+  long l;
+
+  l = strtol (str, &end, 10);
+  if (end == str || l < 0 || l > G_MAXINT)
+    return FALSE;
+
+  *value = l;
+  return TRUE;
+}
+
+/* Follows the rules keyboard_detector_read_step() used when it read
+ * the text form directly */
+static gboolean
+parse_line (Step        *step,
+            char        *line,
+            const char **error)
+{
+  if (g_str_has_prefix (line, "PRESS "))
+    {
+      if (step->type == UNKNOWN)
+        step->type = PRESS_KEY;
+      if (step->type != PRESS_KEY)
+        goto wrong_type;
+      g_ptr_array_add (step->symbols, g_strdup (g_strstrip (line + 6)));
+    }
+  else if (g_str_has_prefix (line, "CODE "))
+    {
+      char **parts;
+      int code[2];
+      gboolean ok;
+
+      if (step->type != PRESS_KEY)
+        goto wrong_type;
+
+      parts = g_strsplit (g_strstrip (line + 5), " ", -1);
+      ok = g_strv_length (parts) == 2 &&
+           parse_int (parts[0], &code[0]) &&
+           parse_int (parts[1], &code[1]);
+      g_strfreev (parts);
+      if (!ok)
+        {
+          *error = "Invalid CODE";
+          return FALSE;
+        }
+      g_array_append_vals (step->codes, code, 2);
+    }
+  else if (g_str_has_prefix (line, "FIND ") || g_str_has_prefix (line, "FINDP "))
+    {
+      gboolean primary = g_str_has_prefix (line, "FINDP ");
+
+      if (step->type != UNKNOWN)
+        goto wrong_type;
+      step->type = primary ? KEY_PRESENT_P : KEY_PRESENT;
+      g_ptr_array_insert (step->symbols, 0,
+                          g_strdup (g_strstrip (line + (primary ? 6 : 5))));
+    }
+  else if (g_str_has_prefix (line, "YES ") || g_str_has_prefix (line, "NO "))
+    {
+      gboolean yes = g_str_has_prefix (line, "YES ");
+
+      if (step->type != KEY_PRESENT && step->type != KEY_PRESENT_P)
+        goto wrong_type;
+      if (!parse_int (g_strstrip (line + (yes ? 4 : 3)),
+                      yes ? &step->present : &step->not_present))
+        {
+          *error = "Invalid step number";
+          return FALSE;
+        }
+    }
+  else if (g_str_has_prefix (line, "MAP "))
+    {
+      char *colon;
+
+      if (step->type == UNKNOWN)
+        step->type = RESULT;
+      if (step->result != NULL)
+        {
+          *error = "More than one MAP";
+          return FALSE;
+        }
+      step->result = g_strdup (g_strstrip (line + 4));
+      /* The Ubuntu file uses colons to separate country codes from layout
+       * variants, and GnomeXkb requires plus signs.
+       */
+      colon = strchr (step->result, ':');
+      if (colon != NULL)
+        *colon = '+';
+    }
+  else
+    {
+      *error = "Unknown instruction";
+      return FALSE;
+    }
+
+  return TRUE;
+
+ wrong_type:
+  *error = "Instruction does not fit the type of the step";
+  return FALSE;
+}
+
+static GVariant *
+step_to_variant (Step *step)
+{
+  GVariantBuilder symbols, codes;
+  guint i;
+
+  g_variant_builder_init (&symbols, G_VARIANT_TYPE_STRING_ARRAY);
+  g_variant_builder_init (&codes, G_VARIANT_TYPE ("a(ii)"));
+
+  if (step == NULL)
+    return g_variant_new (DETECTOR_STEP_TYPE, UNKNOWN, &symbols, &codes, -1, -1, "");
+
+  for (i = 0; i < step->symbols->len; i++)
+    g_variant_builder_add (&symbols, "s", g_ptr_array_index (step->symbols, i));
+  for (i = 0; i + 1 < step->codes->len; i += 2)
+    g_variant_builder_add (&codes, "(ii)",
+                           g_array_index (step->codes, int, i),
+                           g_array_index (step->codes, int, i + 1));
+
+  return g_variant_new (DETECTOR_STEP_TYPE, step->type, &symbols, &codes,
+                        step->present, step->not_present,
+                        step->result ? step->result : "");
+}
+
+int
+main (int argc, char **argv)
+{
+  GError *error = NULL;
+  GPtrArray *steps;
+  GVariantBuilder builder;
+  GVariant *tree;
+  Step *step = NULL;
+  char *contents;
+  char **lines;
+  guint i;
+  int ret = EXIT_FAILURE;
+
+  if (argc != 3)
+    {
+      g_printerr ("Usage: %s INPUT OUTPUT\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  if (!g_file_get_contents (argv[1], &contents, NULL, &error))
+    {
+      g_printerr ("Could not load %s: %s\n", argv[1], error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  steps = g_ptr_array_new_with_free_func (step_free);
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      const char *message = NULL;
+      int number;
+
+      if (*g_strstrip (lines[i]) == '\0')
+        continue;
+
+      if (g_str_has_prefix (lines[i], "STEP "))
+        {
+          if (!parse_int (lines[i] + 5, &number))
+            message = "Invalid step number";
+          else if (number < (int) steps->len && g_ptr_array_index (steps, number) != NULL)
+            message = "Duplicate step";
+          else
+            {
+              if (number >= (int) steps->len)
+                g_ptr_array_set_size (steps, number + 1);
+
+              step = g_new0 (Step, 1);
+              step->type = UNKNOWN;
+              step->symbols = g_ptr_array_new_with_free_func (g_free);
+              step->codes = g_array_new (FALSE, FALSE, sizeof (int));
+              step->present = -1;
+              step->not_present = -1;
+              g_ptr_array_index (steps, number) = step;
+            }
+        }
+      else if (step == NULL)
+        message = "Instruction outside of a step";
+      else
+        parse_line (step, lines[i], &message);
+
+      if (message != NULL)
+        {
+          g_printerr ("%s:%u: %s\n", argv[1], i + 1, message);
+          goto out;
+        }
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" DETECTOR_STEP_TYPE));
+  for (i = 0; i < steps->len; i++)
+    g_variant_builder_add_value (&builder, step_to_variant (g_ptr_array_index (steps, i)));
+  tree = g_variant_ref_sink (g_variant_builder_end (&builder));
+  if (G_BYTE_ORDER == G_BIG_ENDIAN)
+    {
+      GVariant *swapped = g_variant_byteswap (tree);
+
+      g_variant_unref (tree);
+      tree = swapped;
+    }
+
+  if (!g_file_set_contents (argv[2],
+                            g_variant_get_data (tree),
+                            g_variant_get_size (tree),
+                            &error))
+    {
+      g_printerr ("Could not save %s: %s\n", argv[2], error->message);
+      g_error_free (error);
+    }
+  else
+    ret = EXIT_SUCCESS;
+
+  g_variant_unref (tree);
+
+ out:
+  g_strfreev (lines);
+  g_free (contents);
+  g_ptr_array_unref (steps);
+
+  return ret;
+}
@@ -65,9 +65,25 @@ struct _CcLanguageChooserPrivate
         gboolean showing_extra;
         gchar **filter_words;
         gchar *language;
+
+        /* All LanguageWidgets, and an index of the n-grams in their
+         * normalized names; see build_search_index() */
+        GPtrArray *language_widgets;
+        GHashTable *search_index;
+
+        /* Rows for the extra languages are only created when they
+         * are shown, a batch per idle; see add_extra_rows() */
+        guint add_rows_id;
+        guint next_row;
+
+        GCancellable *cancellable;
 };
 
+/* How long to spend creating rows before letting a frame be drawn */
+#define ROW_BATCH_BUDGET_US 8000
+
 typedef struct {
+        /* NULL until the row has been created */
         GtkWidget *box;
         GtkWidget *checkmark;
 
@@ -76,6 +92,14 @@ typedef struct {
         gchar *locale_current_name;
         gchar *locale_untranslated_name;
         gboolean is_extra;
+
+        /* The names above, normalized for filtering and sorting */
+        gchar *locale_name_key;
+        gchar *locale_current_name_key;
+        gchar *locale_untranslated_name_key;
+
+        /* Whether the names match the current filter */
+        gboolean matches;
 } LanguageWidget;
 
 static LanguageWidget *
@@ -101,35 +125,49 @@ language_widget_free (gpointer data)
 {
         LanguageWidget *widget = data;
 
-        /* This is called when the box is destroyed,
-         * so don't bother destroying the widget and
-         * children again. */
+        /* The box belongs to the list, and is destroyed with it */
         g_free (widget->locale_id);
         g_free (widget->locale_name);
         g_free (widget->locale_current_name);
         g_free (widget->locale_untranslated_name);
+        g_free (widget->locale_name_key);
+        g_free (widget->locale_current_name_key);
+        g_free (widget->locale_untranslated_name_key);
         g_free (widget);
 }
 
-static GtkWidget *
+static LanguageWidget *
 language_widget_new (const char *locale_id,
                      gboolean    is_extra)
 {
         gchar *locale_name, *locale_current_name, *locale_untranslated_name;
-        GtkWidget *checkmark;
         LanguageWidget *widget = g_new0 (LanguageWidget, 1);
 
-        locale_name = gnome_get_language_from_locale (locale_id, locale_id);
-        locale_current_name = gnome_get_language_from_locale (locale_id, NULL);
-        locale_untranslated_name = gnome_get_language_from_locale (locale_id, "C");
+        locale_name = cc_common_language_get_display_name (locale_id, locale_id);
+        locale_current_name = cc_common_language_get_display_name (locale_id, NULL);
+        locale_untranslated_name = cc_common_language_get_display_name (locale_id, "C");
 
-        widget->box = padded_label_new (locale_name);
         widget->locale_id = g_strdup (locale_id);
         widget->locale_name = locale_name;
         widget->locale_current_name = locale_current_name;
         widget->locale_untranslated_name = locale_untranslated_name;
         widget->is_extra = is_extra;
 
+        widget->locale_name_key = cc_util_normalize_casefold_and_unaccent (locale_name);
+        widget->locale_current_name_key = cc_util_normalize_casefold_and_unaccent (locale_current_name);
+        widget->locale_untranslated_name_key = cc_util_normalize_casefold_and_unaccent (locale_untranslated_name);
+        widget->matches = TRUE;
+
+        return widget;
+}
+
+static GtkWidget *
+language_widget_create_box (LanguageWidget *widget)
+{
+        GtkWidget *checkmark;
+
+        widget->box = padded_label_new (widget->locale_name);
+
         /* We add a check on each side of the label to keep it centered. */
         checkmark = gtk_image_new_from_icon_name ("object-select-symbolic", GTK_ICON_SIZE_MENU);
         gtk_widget_show (checkmark);
@@ -142,8 +180,7 @@ language_widget_new (const char *locale_id,
                             FALSE, FALSE, 0);
         gtk_widget_show (widget->checkmark);
 
-        g_object_set_data_full (G_OBJECT (widget->box), "language-widget", widget,
-                                language_widget_free);
+        g_object_set_data (G_OBJECT (widget->box), "language-widget", widget);
 
         return widget->box;
 }
@@ -262,6 +299,60 @@ no_results_widget_new (void)
         return widget;
 }
 
+static void
+add_row (CcLanguageChooser *chooser,
+         LanguageWidget    *widget)
+{
+        CcLanguageChooserPrivate *priv = chooser->priv;
+        GtkWidget *row;
+
+        gtk_container_add (GTK_CONTAINER (priv->language_list),
+                           language_widget_create_box (widget));
+        gtk_widget_show_all (widget->box);
+
+        row = gtk_widget_get_parent (widget->box);
+        gtk_widget_show (row);
+        sync_checkmark (row, chooser);
+}
+
+static gboolean
+add_extra_rows_idle (gpointer user_data)
+{
+        CcLanguageChooser *chooser = user_data;
+        CcLanguageChooserPrivate *priv = chooser->priv;
+        gint64 deadline;
+
+        deadline = g_get_monotonic_time () + ROW_BATCH_BUDGET_US;
+
+        while (priv->next_row < priv->language_widgets->len) {
+                LanguageWidget *widget = g_ptr_array_index (priv->language_widgets,
+                                                            priv->next_row++);
+
+                if (widget->box == NULL)
+                        add_row (chooser, widget);
+
+                if (g_get_monotonic_time () >= deadline)
+                        return G_SOURCE_CONTINUE;
+        }
+
+        priv->add_rows_id = 0;
+
+        return G_SOURCE_REMOVE;
+}
+
+/* The idle runs below redraw priority, so the list is drawn and stays
+ * responsive while it fills up */
+static void
+add_extra_rows (CcLanguageChooser *chooser)
+{
+        CcLanguageChooserPrivate *priv = chooser->priv;
+
+        if (priv->add_rows_id != 0 || priv->next_row >= priv->language_widgets->len)
+                return;
+
+        priv->add_rows_id = g_idle_add (add_extra_rows_idle, chooser);
+}
+
 static void
 add_languages (CcLanguageChooser  *chooser,
                char               **locale_ids,
@@ -272,7 +363,7 @@ add_languages (CcLanguageChooser  *chooser,
         while (*locale_ids) {
                 const gchar *locale_id;
                 gboolean is_initial;
-                GtkWidget *widget;
+                LanguageWidget *widget;
 
                 locale_id = *locale_ids;
                 locale_ids ++;
@@ -282,8 +373,11 @@ add_languages (CcLanguageChooser  *chooser,
 
                 is_initial = (g_hash_table_lookup (initial, locale_id) != NULL);
                 widget = language_widget_new (locale_id, !is_initial);
+                g_ptr_array_add (priv->language_widgets, widget);
 
-                gtk_container_add (GTK_CONTAINER (priv->language_list), widget);
+                if (is_initial || g_strcmp0 (locale_id, priv->language) == 0)
+                        gtk_container_add (GTK_CONTAINER (priv->language_list),
+                                           language_widget_create_box (widget));
         }
 
         gtk_container_add (GTK_CONTAINER (priv->language_list), priv->more_item);
@@ -292,17 +386,207 @@ add_languages (CcLanguageChooser  *chooser,
         gtk_widget_show_all (priv->language_list);
 }
 
+/* Languages used by other users are offered along with the initial
+ * ones, once accountsservice has told us about them */
+static void
+other_users_languages_cb (GObject      *source,
+                          GAsyncResult *result,
+                          gpointer      user_data)
+{
+        CcLanguageChooser *chooser;
+        CcLanguageChooserPrivate *priv;
+        gchar **languages;
+        GError *error = NULL;
+        guint i, j;
+
+        languages = cc_common_language_get_other_users_languages_finish (result, &error);
+        if (languages == NULL) {
+                if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                        g_warning ("Failed to list existing users: %s", error->message);
+                g_error_free (error);
+                return;
+        }
+
+        chooser = user_data;
+        priv = chooser->priv;
+
+        for (i = 0; i < priv->language_widgets->len; i++) {
+                LanguageWidget *widget = g_ptr_array_index (priv->language_widgets, i);
+
+                if (!widget->is_extra)
+                        continue;
+
+                for (j = 0; languages[j] != NULL; j++) {
+                        if (!g_str_equal (widget->locale_id, languages[j]))
+                                continue;
+
+                        widget->is_extra = FALSE;
+                        if (widget->box == NULL)
+                                add_row (chooser, widget);
+                        else
+                                gtk_list_box_row_changed (GTK_LIST_BOX_ROW (gtk_widget_get_parent (widget->box)));
+                        break;
+                }
+        }
+
+        g_strfreev (languages);
+}
+
 static void
 add_all_languages (CcLanguageChooser *chooser)
 {
         char **locale_ids;
         GHashTable *initial;
 
-        locale_ids = gnome_get_all_locales ();
+        locale_ids = cc_common_language_get_all_locales ();
         initial = cc_common_language_get_initial_languages ();
         add_languages (chooser, locale_ids, initial);
-        g_hash_table_destroy (initial);
+        g_hash_table_unref (initial);
         g_strfreev (locale_ids);
+
+        cc_common_language_get_other_users_languages_async (chooser->priv->cancellable,
+                                                            other_users_languages_cb,
+                                                            chooser);
+}
+
+/* Only the name in the current language depends on the locale */
+static void
+update_current_name (LanguageWidget *widget)
+{
+        g_free (widget->locale_current_name);
+        g_free (widget->locale_current_name_key);
+        widget->locale_current_name = cc_common_language_get_display_name (widget->locale_id, NULL);
+        widget->locale_current_name_key = cc_util_normalize_casefold_and_unaccent (widget->locale_current_name);
+}
+
+/* The filter matches words anywhere in a name, so every name is
+ * indexed by all of its 1, 2 and 3 byte substrings.  Entries are
+ * name ids, 3 per widget, in increasing order. */
+#define NGRAM_MAX 3
+#define NAMES_PER_WIDGET 3
+
+static const gchar *
+get_name_key (LanguageWidget *widget,
+              guint           name)
+{
+        switch (name) {
+        case 0:
+                return widget->locale_name_key;
+        case 1:
+                return widget->locale_current_name_key;
+        default:
+                return widget->locale_untranslated_name_key;
+        }
+}
+
+static void
+index_name (GHashTable  *index,
+            const gchar *key,
+            guint        id)
+{
+        gsize len, i, n;
+
+        len = strlen (key);
+        for (i = 0; i < len; i++) {
+                for (n = 1; n <= NGRAM_MAX && i + n <= len; n++) {
+                        gchar *gram = g_strndup (key + i, n);
+                        GArray *ids;
+
+                        ids = g_hash_table_lookup (index, gram);
+                        if (ids == NULL) {
+                                ids = g_array_new (FALSE, FALSE, sizeof (guint));
+                                g_hash_table_insert (index, gram, ids);
+                        } else {
+                                g_free (gram);
+                        }
+
+                        if (ids->len == 0 || g_array_index (ids, guint, ids->len - 1) != id)
+                                g_array_append_val (ids, id);
+                }
+        }
+}
+
+static void
+build_search_index (CcLanguageChooser *chooser)
+{
+        CcLanguageChooserPrivate *priv = chooser->priv;
+        guint i, name;
+
+        g_clear_pointer (&priv->search_index, g_hash_table_destroy);
+        priv->search_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                    (GDestroyNotify) g_array_unref);
+
+        for (i = 0; i < priv->language_widgets->len; i++) {
+                LanguageWidget *widget = g_ptr_array_index (priv->language_widgets, i);
+
+                for (name = 0; name < NAMES_PER_WIDGET; name++)
+                        index_name (priv->search_index, get_name_key (widget, name),
+                                    i * NAMES_PER_WIDGET + name);
+        }
+}
+
+/* Keeps the ids in @a which are also in @b */
+static void
+intersect_ids (GArray *a,
+               GArray *b)
+{
+        guint i = 0, j = 0, k = 0;
+
+        while (i < a->len && j < b->len) {
+                guint ia = g_array_index (a, guint, i);
+                guint ib = g_array_index (b, guint, j);
+
+                if (ia < ib) {
+                        i++;
+                } else if (ia > ib) {
+                        j++;
+                } else {
+                        g_array_index (a, guint, k++) = ia;
+                        i++;
+                        j++;
+                }
+        }
+
+        g_array_set_size (a, k);
+}
+
+/* Returns the ids of the names which may contain all of @words;
+ * NULL means all of them */
+static GArray *
+lookup_candidates (GHashTable  *index,
+                   gchar      **words)
+{
+        GArray *candidates = NULL;
+        gchar **w;
+
+        for (w = words; *w; ++w) {
+                gsize len = strlen (*w);
+                gsize i, n;
+
+                n = MIN (len, NGRAM_MAX);
+                for (i = 0; n > 0 && i + n <= len; i++) {
+                        gchar *gram = g_strndup (*w + i, n);
+                        GArray *ids = g_hash_table_lookup (index, gram);
+
+                        g_free (gram);
+
+                        if (ids == NULL) {
+                                if (candidates == NULL)
+                                        candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+                                g_array_set_size (candidates, 0);
+                                return candidates;
+                        }
+
+                        if (candidates == NULL) {
+                                candidates = g_array_sized_new (FALSE, FALSE, sizeof (guint), ids->len);
+                                g_array_append_vals (candidates, ids->data, ids->len);
+                        } else {
+                                intersect_ids (candidates, ids);
+                        }
+                }
+        }
+
+        return candidates;
 }
 
 static gboolean
@@ -324,11 +608,7 @@ language_visible (GtkListBoxRow *row,
 {
         CcLanguageChooser *chooser = user_data;
         CcLanguageChooserPrivate *priv = chooser->priv;
-        gchar *locale_name = NULL;
-        gchar *locale_current_name = NULL;
-        gchar *locale_untranslated_name = NULL;
         LanguageWidget *widget;
-        gboolean visible;
         GtkWidget *child;
 
         child = gtk_bin_get_child (GTK_BIN (row));
@@ -340,31 +620,7 @@ language_visible (GtkListBoxRow *row,
         if (!priv->showing_extra && widget->is_extra)
                 return FALSE;
 
-        if (!priv->filter_words)
-                return TRUE;
-
-        visible = FALSE;
-
-        locale_name = cc_util_normalize_casefold_and_unaccent (widget->locale_name);
-        visible = match_all (priv->filter_words, locale_name);
-        if (visible)
-                goto out;
-
-        locale_current_name = cc_util_normalize_casefold_and_unaccent (widget->locale_current_name);
-        visible = match_all (priv->filter_words, locale_current_name);
-        if (visible)
-                goto out;
-
-        locale_untranslated_name = cc_util_normalize_casefold_and_unaccent (widget->locale_untranslated_name);
-        visible = match_all (priv->filter_words, locale_untranslated_name);
-        if (visible)
-                goto out;
-
- out:
-        g_free (locale_untranslated_name);
-        g_free (locale_current_name);
-        g_free (locale_name);
-        return visible;
+        return widget->matches;
 }
 
 static gint
@@ -373,8 +629,6 @@ sort_languages (GtkListBoxRow *a,
                 gpointer       data)
 {
         LanguageWidget *la, *lb;
-        gchar *normalized_a, *normalized_b;
-        gint retval;
 
         la = get_language_widget (gtk_bin_get_child (GTK_BIN (a)));
         lb = get_language_widget (gtk_bin_get_child (GTK_BIN (b)));
@@ -385,15 +639,73 @@ sort_languages (GtkListBoxRow *a,
         if (lb == NULL)
                 return -1;
 
-        normalized_a = cc_util_normalize_casefold_and_unaccent (la->locale_name);
-        normalized_b = cc_util_normalize_casefold_and_unaccent (lb->locale_name);
+        return strcmp (la->locale_name_key, lb->locale_name_key);
+}
+
+/* Works out which rows match the filter, and only asks the list to
+ * refilter the rows where that changed */
+static void
+update_matches (CcLanguageChooser *chooser)
+{
+        CcLanguageChooserPrivate *priv = chooser->priv;
+        GArray *candidates = NULL;
+        guint8 *matches;
+        guint i;
+
+        if (priv->filter_words)
+                candidates = lookup_candidates (priv->search_index, priv->filter_words);
 
-        retval = strcmp (normalized_a, normalized_b);
+        matches = g_new0 (guint8, priv->language_widgets->len);
 
-        g_free (normalized_a);
-        g_free (normalized_b);
+        if (candidates == NULL) {
+                memset (matches, TRUE, priv->language_widgets->len);
+        } else {
+                for (i = 0; i < candidates->len; i++) {
+                        guint id = g_array_index (candidates, guint, i);
+                        guint index = id / NAMES_PER_WIDGET;
+                        LanguageWidget *widget;
+
+                        if (matches[index])
+                                continue;
+
+                        /* n-grams can match in the wrong order */
+                        widget = g_ptr_array_index (priv->language_widgets, index);
+                        matches[index] = match_all (priv->filter_words,
+                                                    get_name_key (widget, id % NAMES_PER_WIDGET));
+                }
+                g_array_unref (candidates);
+        }
+
+        for (i = 0; i < priv->language_widgets->len; i++) {
+                LanguageWidget *widget = g_ptr_array_index (priv->language_widgets, i);
+
+                if (widget->matches == matches[i])
+                        continue;
+
+                widget->matches = matches[i];
+
+                /* Rows still to be created will pick it up then */
+                if (widget->box == NULL)
+                        continue;
+
+                gtk_list_box_row_changed (GTK_LIST_BOX_ROW (gtk_widget_get_parent (widget->box)));
+        }
+
+        g_free (matches);
+}
+
+static void
+show_more (CcLanguageChooser *chooser)
+{
+        CcLanguageChooserPrivate *priv = chooser->priv;
 
-        return retval;
+        gtk_widget_show (priv->filter_entry);
+        gtk_widget_grab_focus (priv->filter_entry);
+
+        priv->showing_extra = TRUE;
+        gtk_list_box_invalidate_filter (GTK_LIST_BOX (priv->language_list));
+        add_extra_rows (chooser);
+        g_object_notify_by_pspec (G_OBJECT (chooser), obj_props[PROP_SHOWING_EXTRA]);
 }
 
 static void
@@ -411,20 +723,8 @@ filter_changed (GtkEntry        *entry,
                 return;
         priv->filter_words = g_strsplit_set (g_strstrip (filter_contents), " ", 0);
         g_free (filter_contents);
-        gtk_list_box_invalidate_filter (GTK_LIST_BOX (priv->language_list));
-}
-
-static void
-show_more (CcLanguageChooser *chooser)
-{
-        CcLanguageChooserPrivate *priv = chooser->priv;
-
-        gtk_widget_show (priv->filter_entry);
-        gtk_widget_grab_focus (priv->filter_entry);
 
-        priv->showing_extra = TRUE;
-        gtk_list_box_invalidate_filter (GTK_LIST_BOX (priv->language_list));
-        g_object_notify_by_pspec (G_OBJECT (chooser), obj_props[PROP_SHOWING_EXTRA]);
+        update_matches (chooser);
 }
 
 static void
@@ -432,6 +732,7 @@ set_locale_id (CcLanguageChooser *chooser,
                const gchar       *new_locale_id)
 {
         CcLanguageChooserPrivate *priv = chooser->priv;
+        guint i;
 
         if (g_strcmp0 (priv->language, new_locale_id) == 0)
                 return;
@@ -439,6 +740,16 @@ set_locale_id (CcLanguageChooser *chooser,
         g_free (priv->language);
         priv->language = g_strdup (new_locale_id);
 
+        /* The selected row must be there to show its checkmark */
+        for (i = 0; priv->language_widgets && i < priv->language_widgets->len; i++) {
+                LanguageWidget *widget = g_ptr_array_index (priv->language_widgets, i);
+
+                if (widget->box == NULL && g_strcmp0 (widget->locale_id, new_locale_id) == 0) {
+                        add_row (chooser, widget);
+                        break;
+                }
+        }
+
         sync_all_checkmarks (chooser);
 
         g_object_notify_by_pspec (G_OBJECT (chooser), obj_props[PROP_LANGUAGE]);
@@ -518,7 +829,15 @@ cc_language_chooser_constructed (GObject *object)
                                       update_header_func, chooser, NULL);
         gtk_list_box_set_selection_mode (GTK_LIST_BOX (priv->language_list),
                                          GTK_SELECTION_NONE);
+
+        if (priv->language == NULL)
+                priv->language = cc_common_language_get_current_language ();
+
+        /* The initial and selected languages get rows straight away,
+         * and the rest arrive in batches after the first paint */
         add_all_languages (chooser);
+        build_search_index (chooser);
+        add_extra_rows (chooser);
 
         g_signal_connect (priv->filter_entry, "changed",
                           G_CALLBACK (filter_changed),
@@ -527,9 +846,6 @@ cc_language_chooser_constructed (GObject *object)
         g_signal_connect (priv->language_list, "row-activated",
                           G_CALLBACK (row_activated), chooser);
 
-        if (priv->language == NULL)
-                priv->language = cc_common_language_get_current_language ();
-
         sync_all_checkmarks (chooser);
 
         g_object_unref (builder);
@@ -572,6 +888,25 @@ cc_language_chooser_set_property (GObject      *object,
         }
 }
 
+static void
+cc_language_chooser_dispose (GObject *object)
+{
+        CcLanguageChooser *chooser = CC_LANGUAGE_CHOOSER (object);
+        CcLanguageChooserPrivate *priv = chooser->priv;
+
+        if (priv->add_rows_id != 0) {
+                g_source_remove (priv->add_rows_id);
+                priv->add_rows_id = 0;
+        }
+
+        if (priv->cancellable != NULL) {
+                g_cancellable_cancel (priv->cancellable);
+                g_clear_object (&priv->cancellable);
+        }
+
+        G_OBJECT_CLASS (cc_language_chooser_parent_class)->dispose (object);
+}
+
 static void
 cc_language_chooser_finalize (GObject *object)
 {
@@ -579,6 +914,10 @@ cc_language_chooser_finalize (GObject *object)
         CcLanguageChooserPrivate *priv = chooser->priv;
 
         g_strfreev (priv->filter_words);
+        g_clear_pointer (&priv->language_widgets, g_ptr_array_unref);
+        g_clear_pointer (&priv->search_index, g_hash_table_destroy);
+
+        G_OBJECT_CLASS (cc_language_chooser_parent_class)->finalize (object);
 }
 
 static void
@@ -590,6 +929,7 @@ cc_language_chooser_class_init (CcLanguageChooserClass *klass)
 
         object_class->get_property = cc_language_chooser_get_property;
         object_class->set_property = cc_language_chooser_set_property;
+        object_class->dispose = cc_language_chooser_dispose;
         object_class->finalize = cc_language_chooser_finalize;
         object_class->constructed = cc_language_chooser_constructed;
 
@@ -609,6 +949,8 @@ cc_language_chooser_init (CcLanguageChooser *chooser)
 {
         chooser->priv = GET_PRIVATE (chooser);
         chooser->priv->showing_extra = TRUE;
+        chooser->priv->language_widgets = g_ptr_array_new_with_free_func (language_widget_free);
+        chooser->priv->cancellable = g_cancellable_new ();
 }
 
 void
@@ -632,6 +974,20 @@ cc_language_chooser_set_language (CcLanguageChooser *chooser,
         set_locale_id (chooser, language);
 }
 
+void
+cc_language_chooser_locale_changed (CcLanguageChooser *chooser)
+{
+        CcLanguageChooserPrivate *priv = chooser->priv;
+
+        guint i;
+
+        for (i = 0; i < priv->language_widgets->len; i++)
+                update_current_name (g_ptr_array_index (priv->language_widgets, i));
+
+        build_search_index (chooser);
+        update_matches (chooser);
+}
+
 gboolean
 cc_language_chooser_get_showing_extra (CcLanguageChooser *chooser)
 {
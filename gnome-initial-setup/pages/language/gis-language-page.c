@@ -257,6 +257,9 @@ gis_language_page_locale_changed (GisPage *page)
     gtk_label_set_text (GTK_LABEL (priv->welcome_text), _("Welcome to Endless!"));
   if (priv->set_up_text)
     gtk_label_set_text (GTK_LABEL (priv->set_up_text), _("Let’s set up your computer…"));
+
+  if (priv->language_chooser)
+    cc_language_chooser_locale_changed (CC_LANGUAGE_CHOOSER (priv->language_chooser));
 }
 
 static void
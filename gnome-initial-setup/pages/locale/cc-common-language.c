@@ -0,0 +1,1030 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2009-2010  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Written by: Matthias Clasen <mclasen@redhat.com>
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#include <fontconfig/fontconfig.h>
+
+#define GNOME_DESKTOP_USE_UNSTABLE_API
+#include <libgnome-desktop/gnome-languages.h>
+
+#include "cc-common-language.h"
+
+static char *get_lang_for_user_object_path (const char *path);
+
+#define FONT_CACHE_GROUP "Font Languages"
+
+/* Language codes covered by at least one installed font */
+static GHashTable *font_languages = NULL;
+
+/* Identifies the state of the fontconfig caches which the cached
+ * coverage was computed from; any font change touches one of them. */
+static gchar *
+get_font_cache_key (void)
+{
+        GString *key;
+        FcStrList *dirs;
+        FcChar8 *dir;
+
+        key = g_string_new (NULL);
+        g_string_append_printf (key, "%d", FcGetVersion ());
+
+        dirs = FcConfigGetCacheDirs (NULL);
+        if (dirs != NULL) {
+                while ((dir = FcStrListNext (dirs)) != NULL) {
+                        GStatBuf buf;
+
+                        if (g_stat ((const gchar *) dir, &buf) == 0)
+                                g_string_append_printf (key, ";%s:%" G_GINT64_FORMAT,
+                                                        dir, (gint64) buf.st_mtime);
+                }
+                FcStrListDone (dirs);
+        }
+
+        return g_string_free (key, FALSE);
+}
+
+static gchar *
+get_font_cache_path (void)
+{
+        return g_build_filename (g_get_user_cache_dir (),
+                                 "gnome-initial-setup",
+                                 "font-languages",
+                                 NULL);
+}
+
+static GHashTable *
+load_font_languages (const gchar *path,
+                     const gchar *cache_key)
+{
+        GKeyFile *keyfile;
+        GHashTable *languages = NULL;
+        gchar *key = NULL;
+        gchar **langs = NULL;
+        gint i;
+
+        keyfile = g_key_file_new ();
+        if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, NULL))
+                goto out;
+
+        key = g_key_file_get_string (keyfile, FONT_CACHE_GROUP, "Key", NULL);
+        if (g_strcmp0 (key, cache_key) != 0)
+                goto out;
+
+        langs = g_key_file_get_string_list (keyfile, FONT_CACHE_GROUP, "Languages", NULL, NULL);
+        if (langs == NULL)
+                goto out;
+
+        languages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        for (i = 0; langs[i] != NULL; i++)
+                g_hash_table_add (languages, g_strdup (langs[i]));
+
+ out:
+        g_strfreev (langs);
+        g_free (key);
+        g_key_file_free (keyfile);
+
+        return languages;
+}
+
+static void
+save_font_languages (const gchar *path,
+                     const gchar *cache_key,
+                     GHashTable  *languages)
+{
+        GKeyFile *keyfile;
+        const gchar **langs;
+        gchar *dir, *data;
+        gsize length;
+        GError *error = NULL;
+
+        dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (dir, 0755);
+        g_free (dir);
+
+        langs = (const gchar **) g_hash_table_get_keys_as_array (languages, &length);
+
+        keyfile = g_key_file_new ();
+        g_key_file_set_string (keyfile, FONT_CACHE_GROUP, "Key", cache_key);
+        g_key_file_set_string_list (keyfile, FONT_CACHE_GROUP, "Languages", langs, length);
+
+        data = g_key_file_to_data (keyfile, &length, NULL);
+        if (!g_file_set_contents (path, data, length, &error)) {
+                g_debug ("Could not save font language cache: %s", error->message);
+                g_error_free (error);
+        }
+
+        g_free (data);
+        g_free (langs);
+        g_key_file_free (keyfile);
+}
+
+/* One pass over all fonts, collecting the language part of every
+ * language they cover */
+static GHashTable *
+scan_font_languages (void)
+{
+        GHashTable *languages;
+        FcPattern *pattern;
+        FcObjectSet *object_set;
+        FcFontSet *font_set;
+        gint i;
+
+        languages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        pattern = FcPatternCreate ();
+        object_set = FcObjectSetBuild (FC_LANG, NULL);
+        font_set = FcFontList (NULL, pattern, object_set);
+
+        for (i = 0; font_set != NULL && i < font_set->nfont; i++) {
+                FcLangSet *lang_set;
+                FcStrSet *langs;
+                FcStrList *list;
+                FcChar8 *lang;
+
+                if (FcPatternGetLangSet (font_set->fonts[i], FC_LANG, 0, &lang_set) != FcResultMatch)
+                        continue;
+
+                langs = FcLangSetGetLangs (lang_set);
+                list = FcStrListCreate (langs);
+                while ((lang = FcStrListNext (list)) != NULL) {
+                        const gchar *dash = strchr ((const gchar *) lang, '-');
+
+                        if (dash != NULL)
+                                g_hash_table_add (languages,
+                                                  g_strndup ((const gchar *) lang,
+                                                             dash - (const gchar *) lang));
+                        else
+                                g_hash_table_add (languages, g_strdup ((const gchar *) lang));
+                }
+                FcStrListDone (list);
+                FcStrSetDestroy (langs);
+        }
+
+        if (font_set != NULL)
+                FcFontSetDestroy (font_set);
+        FcObjectSetDestroy (object_set);
+        FcPatternDestroy (pattern);
+
+        return languages;
+}
+
+static GHashTable *
+get_font_languages (void)
+{
+        gchar *path, *cache_key;
+
+        if (font_languages != NULL)
+                return font_languages;
+
+        path = get_font_cache_path ();
+        cache_key = get_font_cache_key ();
+
+        font_languages = load_font_languages (path, cache_key);
+        if (font_languages == NULL) {
+                font_languages = scan_font_languages ();
+                save_font_languages (path, cache_key, font_languages);
+        }
+
+        g_free (cache_key);
+        g_free (path);
+
+        return font_languages;
+}
+
+#define INDEX_GROUP "Index"
+#define TRANSLATIONS_GROUP "Translations"
+
+/* The installed locales and which languages have translations; both
+ * otherwise probe the locale archive or the message catalogues every
+ * time they are asked. */
+static GKeyFile *locale_index = NULL;
+static guint save_locale_index_id = 0;
+
+static gchar *
+get_locale_index_path (void)
+{
+        return g_build_filename (g_get_user_cache_dir (),
+                                 "gnome-initial-setup",
+                                 "locale-index",
+                                 NULL);
+}
+
+/* Installing a locale touches one of these; translations are checked
+ * per language, see get_translations_stamp() */
+static gchar *
+get_locale_index_key (void)
+{
+        const gchar *files[] = {
+                LIBLOCALEDIR "/locale-archive",
+                LIBLOCALEDIR,
+        };
+        GString *key;
+        guint i;
+
+        key = g_string_new (PACKAGE_VERSION);
+        for (i = 0; i < G_N_ELEMENTS (files); i++) {
+                GStatBuf buf;
+
+                if (g_stat (files[i], &buf) == 0)
+                        g_string_append_printf (key, ";%" G_GINT64_FORMAT, (gint64) buf.st_mtime);
+        }
+
+        return g_string_free (key, FALSE);
+}
+
+static gboolean
+save_locale_index (gpointer user_data)
+{
+        gchar *path, *dir, *data;
+        gsize length;
+        GError *error = NULL;
+
+        save_locale_index_id = 0;
+
+        path = get_locale_index_path ();
+        dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (dir, 0755);
+
+        data = g_key_file_to_data (locale_index, &length, NULL);
+        if (!g_file_set_contents (path, data, length, &error)) {
+                g_debug ("Could not save locale index: %s", error->message);
+                g_error_free (error);
+        }
+
+        g_free (data);
+        g_free (dir);
+        g_free (path);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+queue_save_locale_index (void)
+{
+        if (save_locale_index_id == 0)
+                save_locale_index_id = g_idle_add (save_locale_index, NULL);
+}
+
+static GKeyFile *
+get_locale_index (void)
+{
+        gchar *path, *key, *cached_key;
+        gchar **locales;
+
+        if (locale_index != NULL)
+                return locale_index;
+
+        path = get_locale_index_path ();
+        key = get_locale_index_key ();
+
+        locale_index = g_key_file_new ();
+        g_key_file_load_from_file (locale_index, path, G_KEY_FILE_NONE, NULL);
+
+        cached_key = g_key_file_get_string (locale_index, INDEX_GROUP, "Key", NULL);
+        if (g_strcmp0 (cached_key, key) != 0 ||
+            !g_key_file_has_key (locale_index, INDEX_GROUP, "Locales", NULL)) {
+                g_key_file_free (locale_index);
+                locale_index = g_key_file_new ();
+                g_key_file_set_string (locale_index, INDEX_GROUP, "Key", key);
+
+                locales = gnome_get_all_locales ();
+                g_key_file_set_string_list (locale_index, INDEX_GROUP, "Locales",
+                                            (const gchar * const *) locales,
+                                            g_strv_length (locales));
+                g_strfreev (locales);
+
+                queue_save_locale_index ();
+        }
+
+        g_free (cached_key);
+        g_free (key);
+        g_free (path);
+
+        return locale_index;
+}
+
+/**
+ * cc_common_language_get_all_locales:
+ *
+ * Like gnome_get_all_locales(), from the locale index.
+ *
+ * Returns: (transfer full): the installed locales
+ */
+gchar **
+cc_common_language_get_all_locales (void)
+{
+        gchar **locales;
+
+        locales = g_key_file_get_string_list (get_locale_index (), INDEX_GROUP, "Locales", NULL, NULL);
+        if (locales == NULL)
+                locales = g_new0 (gchar *, 1);
+
+        return locales;
+}
+
+/* Adding the first .mo file for a language only touches its own
+ * LC_MESSAGES directory, so each answer is kept together with that
+ * directory's mtime and checked again when it changes */
+static gchar *
+get_translations_stamp (const gchar *language)
+{
+        gchar *path;
+        GStatBuf buf;
+        gint64 mtime = -1;
+
+        path = g_build_filename (GNOMELOCALEDIR, language, "LC_MESSAGES", NULL);
+        if (g_stat (path, &buf) == 0)
+                mtime = buf.st_mtime;
+        g_free (path);
+
+        return g_strdup_printf ("%" G_GINT64_FORMAT, mtime);
+}
+
+/**
+ * cc_common_language_has_translations:
+ * @language: a language code, optionally with a territory
+ *
+ * Like gnome_language_has_translations(), remembering the result in
+ * the locale index.
+ */
+gboolean
+cc_common_language_has_translations (const gchar *language)
+{
+        GKeyFile *index;
+        gchar **cached;
+        gchar *stamp;
+        gsize length;
+        gboolean ret;
+
+        index = get_locale_index ();
+        stamp = get_translations_stamp (language);
+
+        cached = g_key_file_get_string_list (index, TRANSLATIONS_GROUP, language, &length, NULL);
+        if (cached != NULL && length == 2 && g_str_equal (cached[1], stamp)) {
+                ret = g_str_equal (cached[0], "true");
+        } else {
+                const gchar *entry[2];
+
+                ret = gnome_language_has_translations (language);
+                entry[0] = ret ? "true" : "false";
+                entry[1] = stamp;
+                g_key_file_set_string_list (index, TRANSLATIONS_GROUP, language, entry, 2);
+                queue_save_locale_index ();
+        }
+
+        g_strfreev (cached);
+        g_free (stamp);
+
+        return ret;
+}
+
+gboolean
+cc_common_language_has_font (const gchar *locale)
+{
+        gchar           *language_code;
+        gboolean         is_displayable;
+
+        if (!gnome_parse_locale (locale, &language_code, NULL, NULL, NULL))
+                return FALSE;
+
+        if (!FcLangGetCharSet ((FcChar8 *) language_code)) {
+                /* fontconfig does not know about this language */
+                is_displayable = TRUE;
+        }
+        else {
+                /* see if any fonts support rendering it */
+                is_displayable = g_hash_table_contains (get_font_languages (),
+                                                        language_code);
+        }
+
+        g_free (language_code);
+
+        return is_displayable;
+}
+
+#define NAMES_CACHE_GROUP "Cache"
+
+/* Locale display names by translation language, see
+ * cc_common_language_get_display_name() */
+static GKeyFile *display_names = NULL;
+static guint save_display_names_id = 0;
+/* Translation languages whose group has been checked in this run */
+static GHashTable *display_names_checked = NULL;
+
+static gchar *
+get_display_names_path (void)
+{
+        return g_build_filename (g_get_user_cache_dir (),
+                                 "gnome-initial-setup",
+                                 "locale-names",
+                                 NULL);
+}
+
+/* The names come from iso-codes, so the cache is only valid for the
+ * version of it that they were computed with; the translations of
+ * each language are checked separately, see get_translation_stamp() */
+static gchar *
+get_display_names_key (void)
+{
+        const gchar *files[] = {
+                ISO_CODES_PREFIX "/share/xml/iso-codes/iso_639.xml",
+                ISO_CODES_PREFIX "/share/xml/iso-codes/iso_3166.xml",
+        };
+        GString *key;
+        guint i;
+
+        key = g_string_new (PACKAGE_VERSION);
+        for (i = 0; i < G_N_ELEMENTS (files); i++) {
+                GStatBuf buf;
+
+                if (g_stat (files[i], &buf) == 0)
+                        g_string_append_printf (key, ";%" G_GINT64_FORMAT, (gint64) buf.st_mtime);
+        }
+
+        return g_string_free (key, FALSE);
+}
+
+/* The iso-codes catalogues that gettext would look up the names in
+ * for @translation */
+static gchar *
+get_translation_stamp (const gchar *translation)
+{
+        const gchar *domains[] = { "iso_639", "iso_3166" };
+        gchar *language_code = NULL, *territory_code = NULL;
+        gchar *dirs[2] = { NULL, NULL };
+        GString *stamp;
+        guint i, j;
+
+        stamp = g_string_new (NULL);
+        if (!gnome_parse_locale (translation, &language_code, &territory_code, NULL, NULL))
+                goto out;
+
+        if (territory_code != NULL)
+                dirs[0] = g_strdup_printf ("%s_%s", language_code, territory_code);
+        dirs[1] = g_strdup (language_code);
+
+        for (i = 0; i < G_N_ELEMENTS (dirs); i++) {
+                if (dirs[i] == NULL)
+                        continue;
+
+                for (j = 0; j < G_N_ELEMENTS (domains); j++) {
+                        gchar *path, *file;
+                        GStatBuf buf;
+
+                        file = g_strconcat (domains[j], ".mo", NULL);
+                        path = g_build_filename (ISO_CODES_PREFIX "/share/locale",
+                                                 dirs[i], "LC_MESSAGES", file, NULL);
+                        if (g_stat (path, &buf) == 0)
+                                g_string_append_printf (stamp, "%s/%s:%" G_GINT64_FORMAT ";",
+                                                        dirs[i], domains[j],
+                                                        (gint64) buf.st_mtime);
+                        g_free (path);
+                        g_free (file);
+                }
+        }
+
+        g_free (dirs[0]);
+        g_free (dirs[1]);
+
+ out:
+        g_free (language_code);
+        g_free (territory_code);
+
+        return g_string_free (stamp, FALSE);
+}
+
+static GKeyFile *
+get_display_names (void)
+{
+        gchar *path, *key, *cached_key;
+
+        if (display_names != NULL)
+                return display_names;
+
+        path = get_display_names_path ();
+        key = get_display_names_key ();
+
+        display_names = g_key_file_new ();
+        g_key_file_load_from_file (display_names, path, G_KEY_FILE_NONE, NULL);
+
+        cached_key = g_key_file_get_string (display_names, NAMES_CACHE_GROUP, "Key", NULL);
+        if (g_strcmp0 (cached_key, key) != 0) {
+                g_key_file_free (display_names);
+                display_names = g_key_file_new ();
+                g_key_file_set_string (display_names, NAMES_CACHE_GROUP, "Key", key);
+        }
+
+        g_free (cached_key);
+        g_free (key);
+        g_free (path);
+
+        return display_names;
+}
+
+static gboolean
+save_display_names (gpointer user_data)
+{
+        gchar *path, *dir, *data;
+        gsize length;
+        GError *error = NULL;
+
+        save_display_names_id = 0;
+
+        path = get_display_names_path ();
+        dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (dir, 0755);
+
+        data = g_key_file_to_data (display_names, &length, NULL);
+        if (!g_file_set_contents (path, data, length, &error)) {
+                g_debug ("Could not save locale name cache: %s", error->message);
+                g_error_free (error);
+        }
+
+        g_free (data);
+        g_free (dir);
+        g_free (path);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+queue_save_display_names (void)
+{
+        if (save_display_names_id == 0)
+                save_display_names_id = g_idle_add (save_display_names, NULL);
+}
+
+/* Drops the names cached for @translation if its catalogues changed;
+ * only done once per language, the first time it is asked for */
+static void
+check_translation (GKeyFile    *names,
+                   const gchar *translation)
+{
+        gchar *stamp, *cached_stamp;
+
+        if (display_names_checked == NULL)
+                display_names_checked = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        else if (g_hash_table_contains (display_names_checked, translation))
+                return;
+
+        g_hash_table_add (display_names_checked, g_strdup (translation));
+
+        stamp = get_translation_stamp (translation);
+        cached_stamp = g_key_file_get_string (names, NAMES_CACHE_GROUP, translation, NULL);
+        if (g_strcmp0 (cached_stamp, stamp) != 0) {
+                g_key_file_remove_group (names, translation, NULL);
+                g_key_file_set_string (names, NAMES_CACHE_GROUP, translation, stamp);
+                queue_save_display_names ();
+        }
+
+        g_free (cached_stamp);
+        g_free (stamp);
+}
+
+/**
+ * cc_common_language_get_display_name:
+ * @locale: the locale to get the name of
+ * @translation: (allow-none): the locale to give the name in, or %NULL
+ *   for the current one
+ *
+ * Like gnome_get_language_from_locale(), but remembers the names it
+ * has looked up, in memory and on disk.
+ *
+ * Returns: the name of the language of @locale, or %NULL
+ */
+gchar *
+cc_common_language_get_display_name (const gchar *locale,
+                                     const gchar *translation)
+{
+        GKeyFile *names;
+        gchar *current = NULL;
+        gchar *name;
+
+        /* Copied, as looking up a name switches LC_MESSAGES */
+        if (translation == NULL)
+                translation = current = g_strdup (setlocale (LC_MESSAGES, NULL));
+
+        names = get_display_names ();
+        check_translation (names, translation);
+
+        name = g_key_file_get_string (names, translation, locale, NULL);
+        if (name != NULL) {
+                if (*name == '\0')
+                        g_clear_pointer (&name, g_free);
+                goto out;
+        }
+
+        name = gnome_get_language_from_locale (locale, translation);
+        g_key_file_set_string (names, translation, locale, name ? name : "");
+        queue_save_display_names ();
+
+ out:
+        g_free (current);
+
+        return name;
+}
+
+gchar *
+cc_common_language_get_current_language (void)
+{
+        gchar *language;
+        char *path;
+        const gchar *locale;
+
+	path = g_strdup_printf ("/org/freedesktop/Accounts/User%d", getuid ());
+        language = get_lang_for_user_object_path (path);
+        g_free (path);
+        if (language != NULL && *language != '\0')
+                return language;
+
+        locale = (const gchar *) setlocale (LC_MESSAGES, NULL);
+        if (locale)
+                language = gnome_normalize_locale (locale);
+        else
+                language = NULL;
+
+        return language;
+}
+
+static gboolean
+user_language_has_translations (const char *locale)
+{
+        char *name, *language_code = NULL, *territory_code = NULL;
+        gboolean ret;
+
+        if (!gnome_parse_locale (locale,
+                                 &language_code,
+                                 &territory_code,
+                                 NULL, NULL)) {
+                g_free (language_code);
+                g_free (territory_code);
+                return FALSE;
+        }
+        name = g_strdup_printf ("%s%s%s",
+                                language_code,
+                                territory_code != NULL? "_" : "",
+                                territory_code != NULL? territory_code : "");
+        g_free (language_code);
+        g_free (territory_code);
+        ret = cc_common_language_has_translations (name);
+        g_free (name);
+
+        return ret;
+}
+
+static char *
+get_lang_for_user_object_path (const char *path)
+{
+	GError *error = NULL;
+	GDBusProxy *user;
+	GVariant *props;
+	char *lang;
+
+	user = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
+					      G_DBUS_PROXY_FLAGS_NONE,
+					      NULL,
+					      "org.freedesktop.Accounts",
+					      path,
+					      "org.freedesktop.Accounts.User",
+					      NULL,
+					      &error);
+	if (user == NULL) {
+		g_warning ("Failed to get proxy for user '%s': %s",
+			   path, error->message);
+		g_error_free (error);
+		return NULL;
+	}
+
+	lang = NULL;
+	props = g_dbus_proxy_get_cached_property (user, "Language");
+	if (props != NULL) {
+		lang = g_variant_dup_string (props, NULL);
+		g_variant_unref (props);
+	}
+
+	g_object_unref (user);
+	return lang;
+}
+
+typedef struct
+{
+        GDBusConnection *bus;
+        GPtrArray *languages;
+        guint pending;
+} OtherUsersData;
+
+static void
+other_users_data_free (OtherUsersData *data)
+{
+        g_clear_object (&data->bus);
+        if (data->languages != NULL)
+                g_ptr_array_unref (data->languages);
+        g_free (data);
+}
+
+/* Keeps the languages which can be offered, normalized and without
+ * duplicates */
+static gchar **
+filter_user_languages (GPtrArray *languages)
+{
+        GPtrArray *filtered;
+        guint i, j;
+
+        filtered = g_ptr_array_new ();
+
+        for (i = 0; i < languages->len; i++) {
+                const char *lang = g_ptr_array_index (languages, i);
+                char *name;
+
+                if (!cc_common_language_has_font (lang) ||
+                    !user_language_has_translations (lang))
+                        continue;
+
+                name = gnome_normalize_locale (lang);
+                for (j = 0; name != NULL && j < filtered->len; j++) {
+                        if (g_str_equal (name, g_ptr_array_index (filtered, j)))
+                                g_clear_pointer (&name, g_free);
+                }
+
+                if (name != NULL)
+                        g_ptr_array_add (filtered, name);
+        }
+
+        g_ptr_array_add (filtered, NULL);
+
+        return (gchar **) g_ptr_array_free (filtered, FALSE);
+}
+
+static void
+got_user_language (GObject      *source,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+        GTask *task = user_data;
+        OtherUsersData *data = g_task_get_task_data (task);
+        GVariant *result, *value;
+        GError *error = NULL;
+
+        result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+        if (result == NULL) {
+                if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                        g_debug ("Failed to get the language of a user: %s", error->message);
+                g_error_free (error);
+        } else {
+                g_variant_get (result, "(v)", &value);
+                if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING) &&
+                    *g_variant_get_string (value, NULL) != '\0')
+                        g_ptr_array_add (data->languages, g_variant_dup_string (value, NULL));
+                g_variant_unref (value);
+                g_variant_unref (result);
+        }
+
+        if (--data->pending == 0)
+                g_task_return_pointer (task, filter_user_languages (data->languages),
+                                       (GDestroyNotify) g_strfreev);
+
+        g_object_unref (task);
+}
+
+static void
+got_cached_users (GObject      *source,
+                  GAsyncResult *res,
+                  gpointer      user_data)
+{
+        GTask *task = user_data;
+        OtherUsersData *data = g_task_get_task_data (task);
+        GVariant *result;
+        GVariantIter *iter;
+        GError *error = NULL;
+        const char *path;
+
+        result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+        if (result == NULL) {
+                g_task_return_error (task, error);
+                g_object_unref (task);
+                return;
+        }
+
+        /* Ask for all the languages at once rather than waiting for
+         * each reply in turn */
+        g_variant_get (result, "(ao)", &iter);
+        while (g_variant_iter_loop (iter, "&o", &path)) {
+                data->pending++;
+                g_dbus_connection_call (data->bus,
+                                        "org.freedesktop.Accounts",
+                                        path,
+                                        "org.freedesktop.DBus.Properties",
+                                        "Get",
+                                        g_variant_new ("(ss)",
+                                                       "org.freedesktop.Accounts.User",
+                                                       "Language"),
+                                        G_VARIANT_TYPE ("(v)"),
+                                        G_DBUS_CALL_FLAGS_NONE,
+                                        -1,
+                                        g_task_get_cancellable (task),
+                                        got_user_language,
+                                        g_object_ref (task));
+        }
+        g_variant_iter_free (iter);
+        g_variant_unref (result);
+
+        if (data->pending == 0)
+                g_task_return_pointer (task, g_new0 (gchar *, 1),
+                                       (GDestroyNotify) g_strfreev);
+
+        g_object_unref (task);
+}
+
+static void
+got_system_bus (GObject      *source,
+                GAsyncResult *res,
+                gpointer      user_data)
+{
+        GTask *task = user_data;
+        OtherUsersData *data = g_task_get_task_data (task);
+        GError *error = NULL;
+
+        data->bus = g_bus_get_finish (res, &error);
+        if (data->bus == NULL) {
+                g_task_return_error (task, error);
+                g_object_unref (task);
+                return;
+        }
+
+        g_dbus_connection_call (data->bus,
+                                "org.freedesktop.Accounts",
+                                "/org/freedesktop/Accounts",
+                                "org.freedesktop.Accounts",
+                                "ListCachedUsers",
+                                NULL,
+                                G_VARIANT_TYPE ("(ao)"),
+                                G_DBUS_CALL_FLAGS_NONE,
+                                -1,
+                                g_task_get_cancellable (task),
+                                got_cached_users,
+                                task);
+}
+
+/**
+ * cc_common_language_get_other_users_languages_async:
+ *
+ * Finds the languages used by the other users on the system, without
+ * blocking on accountsservice.  Only languages which have fonts and
+ * translations are returned.
+ */
+void
+cc_common_language_get_other_users_languages_async (GCancellable        *cancellable,
+                                                    GAsyncReadyCallback  callback,
+                                                    gpointer             user_data)
+{
+        GTask *task;
+        OtherUsersData *data;
+
+        data = g_new0 (OtherUsersData, 1);
+        data->languages = g_ptr_array_new_with_free_func (g_free);
+
+        task = g_task_new (NULL, cancellable, callback, user_data);
+        g_task_set_source_tag (task, cc_common_language_get_other_users_languages_async);
+        g_task_set_task_data (task, data, (GDestroyNotify) other_users_data_free);
+
+        g_bus_get (G_BUS_TYPE_SYSTEM, cancellable, got_system_bus, task);
+}
+
+/**
+ * cc_common_language_get_other_users_languages_finish:
+ *
+ * Returns: (transfer full): a %NULL terminated array of normalized
+ * locale names
+ */
+gchar **
+cc_common_language_get_other_users_languages_finish (GAsyncResult  *result,
+                                                     GError       **error)
+{
+        g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+        return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+insert_language (GHashTable *ht,
+                 const char *lang)
+{
+        gboolean has_translations;
+        char *label_own_lang;
+        char *label_current_lang;
+        char *label_untranslated;
+        char *key;
+
+        has_translations = cc_common_language_has_translations (lang);
+        if (!has_translations) {
+                char *lang_code = g_strndup (lang, 2);
+                has_translations = cc_common_language_has_translations (lang_code);
+                g_free (lang_code);
+
+                if (!has_translations)
+                        return;
+        }
+
+        g_debug ("We have translations for %s", lang);
+
+        key = g_strdup_printf ("%s.utf8", lang);
+
+        label_own_lang = cc_common_language_get_display_name (key, key);
+        label_current_lang = cc_common_language_get_display_name (key, NULL);
+        label_untranslated = cc_common_language_get_display_name (key, "C");
+
+        /* We don't have a translation for the label in
+         * its own language? */
+        if (g_strcmp0 (label_own_lang, label_untranslated) == 0) {
+                if (g_strcmp0 (label_current_lang, label_untranslated) == 0)
+                        g_hash_table_insert (ht, key, g_strdup (label_untranslated));
+                else
+                        g_hash_table_insert (ht, key, g_strdup (label_current_lang));
+        } else {
+                g_hash_table_insert (ht, key, g_strdup (label_own_lang));
+        }
+
+        g_free (label_own_lang);
+        g_free (label_current_lang);
+        g_free (label_untranslated);
+}
+
+static void
+insert_user_languages (GHashTable *ht)
+{
+        char *name;
+        char *language;
+
+        /* The languages used by other users on the system are added
+         * later on; see cc_common_language_get_other_users_languages_async() */
+
+        /* Add current locale */
+        name = cc_common_language_get_current_language ();
+        if (g_hash_table_lookup (ht, name) == NULL) {
+                language = gnome_get_language_from_locale (name, NULL);
+                g_hash_table_insert (ht, name, language);
+        } else {
+                g_free (name);
+        }
+}
+
+/* The labels depend on the language of the UI, so the table is
+ * rebuilt whenever that changes */
+static GHashTable *initial_languages = NULL;
+static gchar *initial_languages_locale = NULL;
+
+/**
+ * cc_common_language_get_initial_languages:
+ *
+ * Returns: (transfer full): a table of locale names to labels, shared
+ * between all callers; release it with g_hash_table_unref()
+ */
+GHashTable *
+cc_common_language_get_initial_languages (void)
+{
+        const gchar *locale;
+
+        locale = setlocale (LC_MESSAGES, NULL);
+        if (initial_languages != NULL &&
+            g_strcmp0 (locale, initial_languages_locale) == 0)
+                return g_hash_table_ref (initial_languages);
+
+        g_clear_pointer (&initial_languages, g_hash_table_unref);
+        g_free (initial_languages_locale);
+        initial_languages_locale = g_strdup (locale);
+
+        initial_languages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+        insert_language (initial_languages, "en_US");
+        insert_user_languages (initial_languages);
+
+        return g_hash_table_ref (initial_languages);
+}
@@ -29,7 +29,17 @@ G_BEGIN_DECLS
 
 gboolean cc_common_language_has_font                (const gchar  *locale);
 gchar   *cc_common_language_get_current_language    (void);
+gchar   *cc_common_language_get_display_name        (const gchar  *locale,
+                                                     const gchar  *translation);
 GHashTable *cc_common_language_get_initial_languages   (void);
+gchar  **cc_common_language_get_all_locales         (void);
+gboolean cc_common_language_has_translations        (const gchar  *language);
+
+void     cc_common_language_get_other_users_languages_async  (GCancellable        *cancellable,
+                                                              GAsyncReadyCallback  callback,
+                                                              gpointer             user_data);
+gchar  **cc_common_language_get_other_users_languages_finish (GAsyncResult        *result,
+                                                              GError             **error);
 
 G_END_DECLS
 
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Compares cc_util_normalize_casefold_and_unaccent() with the
+ * implementation it replaced, for both results and speed.  Not built
+ * by default:
+ *
+ *   make cc-util-benchmark && ./cc-util-benchmark [ITERATIONS]
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "cc-util.h"
+
+#define IS_CDM_UCS4(c) (((c) >= 0x0300 && (c) <= 0x036F)  || \
+                        ((c) >= 0x1DC0 && (c) <= 0x1DFF)  || \
+                        ((c) >= 0x20D0 && (c) <= 0x20FF)  || \
+                        ((c) >= 0xFE20 && (c) <= 0xFE2F))
+
+/* Language, country and layout names of the kind the choosers filter */
+static const char * const samples[] = {
+  "English", "United States", "English (US, international with dead keys)",
+  "German", "Deutsch", "Français", "Español", "Português (Brasil)",
+  "Straße", "Tiếng Việt", "Türkçe", "Ελληνικά", "Русский", "Українська",
+  "ᏣᎳᎩ", "العربية", "עברית", "हिन्दी", "日本語", "中文 (简体)", "한국어",
+  "ﬁnnish ligature", "Ⅻ roman", "ȷ̈ dotless",
+};
+
+/* The implementation before the ASCII fast path */
+static char *
+reference_normalize (const char *str)
+{
+  char *normalized, *tmp;
+  int i = 0, j = 0, ilen;
+
+  normalized = g_utf8_normalize (str, -1, G_NORMALIZE_NFKD);
+  tmp = g_utf8_casefold (normalized, -1);
+  g_free (normalized);
+
+  ilen = strlen (tmp);
+
+  while (i < ilen)
+    {
+      gunichar unichar;
+      gint utf8_len;
+
+      unichar = g_utf8_get_char_validated (&tmp[i], -1);
+      if (unichar == (gunichar) -1 ||
+          unichar == (gunichar) -2)
+        break;
+
+      utf8_len = g_utf8_next_char (&tmp[i]) - &tmp[i];
+
+      if (IS_CDM_UCS4 ((guint32) unichar))
+        {
+          i += utf8_len;
+          continue;
+        }
+
+      if (i != j)
+        memmove (&tmp[j], &tmp[i], utf8_len);
+
+      i += utf8_len;
+      j += utf8_len;
+    }
+
+  tmp[j] = '\0';
+
+  return tmp;
+}
+
+static gint64
+time_run (char     *(*normalize) (const char *),
+          guint      iterations)
+{
+  gint64 start;
+  guint i, s;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    for (s = 0; s < G_N_ELEMENTS (samples); s++)
+      g_free (normalize (samples[s]));
+
+  return g_get_monotonic_time () - start;
+}
+
+int
+main (int argc, char **argv)
+{
+  guint iterations = 100000;
+  gint64 reference, current;
+  int ret = EXIT_SUCCESS;
+  guint s;
+
+  if (argc > 1)
+    iterations = MAX (1, atoi (argv[1]));
+
+  for (s = 0; s < G_N_ELEMENTS (samples); s++)
+    {
+      char *expected = reference_normalize (samples[s]);
+      char *result = cc_util_normalize_casefold_and_unaccent (samples[s]);
+
+      if (strcmp (expected, result) != 0)
+        {
+          g_printerr ("Mismatch for \"%s\": \"%s\" instead of \"%s\"\n",
+                      samples[s], result, expected);
+          ret = EXIT_FAILURE;
+        }
+
+      g_free (expected);
+      g_free (result);
+    }
+
+  reference = time_run (reference_normalize, iterations);
+  current = time_run (cc_util_normalize_casefold_and_unaccent, iterations);
+
+  g_print ("%u iterations over %u strings\n",
+           iterations, (guint) G_N_ELEMENTS (samples));
+  g_print ("  reference:  %8.1f ms\n", reference / 1000.0);
+  g_print ("  current:    %8.1f ms\n", current / 1000.0);
+
+  return ret;
+}
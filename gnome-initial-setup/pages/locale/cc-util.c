@@ -35,71 +35,72 @@
                         ((c) >= 0x20D0 && (c) <= 0x20FF)  || \
                         ((c) >= 0xFE20 && (c) <= 0xFE2F))
 
-/* Copied from tracker/src/libtracker-fts/tracker-parser-glib.c under the GPL
- * And then from gnome-shell/src/shell-util.c
+/* Bytes in a word with the high bit set */
+#define HIGH_BITS (((gsize) -1 / 0xFF) * 0x80)
+
+/* Locale and layout names are almost always ASCII; checks a word at
+ * a time, without reading past the @len bytes of @str */
+static gboolean
+is_ascii (const char *str,
+          gsize       len)
+{
+  gsize i, word;
+
+  for (i = 0; i + sizeof (gsize) <= len; i += sizeof (gsize))
+    {
+      memcpy (&word, str + i, sizeof (gsize));
+      if ((word & HIGH_BITS) != 0)
+        return FALSE;
+    }
+
+  for (; i < len; i++)
+    if (str[i] & 0x80)
+      return FALSE;
+
+  return TRUE;
+}
+
+/* Originally copied from tracker/src/libtracker-fts/tracker-parser-glib.c
+ * under the GPL, and then from gnome-shell/src/shell-util.c
  *
  * Originally written by Aleksander Morgado <aleksander@gnu.org>
  */
 char *
 cc_util_normalize_casefold_and_unaccent (const char *str)
 {
-  char *normalized, *tmp;
-  int i = 0, j = 0, ilen;
+  char *normalized, *folded;
+  char *p, *q;
+  gsize len;
 
   if (str == NULL)
     return NULL;
 
+  len = strlen (str);
+
+  /* NFKD and casefolding leave ASCII alone apart from the case */
+  if (is_ascii (str, len))
+    return g_ascii_strdown (str, len);
+
   normalized = g_utf8_normalize (str, -1, G_NORMALIZE_NFKD);
-  tmp = g_utf8_casefold (normalized, -1);
+  if (normalized == NULL)
+    return g_strdup ("");
+  folded = g_utf8_casefold (normalized, -1);
   g_free (normalized);
 
-  ilen = strlen (tmp);
-
-  while (i < ilen)
+  /* Drop the combining diacritical marks in place */
+  for (p = q = folded; *p != '\0'; )
     {
-      gunichar unichar;
-      gchar *next_utf8;
-      gint utf8_len;
+      char *next = g_utf8_next_char (p);
 
-      /* Get next character of the word as UCS4 */
-      unichar = g_utf8_get_char_validated (&tmp[i], -1);
-
-      /* Invalid UTF-8 character or end of original string. */
-      if (unichar == (gunichar) -1 ||
-          unichar == (gunichar) -2)
-        {
-          break;
-        }
-
-      /* Find next UTF-8 character */
-      next_utf8 = g_utf8_next_char (&tmp[i]);
-      utf8_len = next_utf8 - &tmp[i];
-
-      if (IS_CDM_UCS4 ((guint32) unichar))
+      if (!IS_CDM_UCS4 ((guint32) g_utf8_get_char (p)))
         {
-          /* If the given unichar is a combining diacritical mark,
-           * just update the original index, not the output one */
-          i += utf8_len;
-          continue;
+          if (q != p)
+            memmove (q, p, next - p);
+          q += next - p;
         }
-
-      /* If already found a previous combining
-       * diacritical mark, indexes are different so
-       * need to copy characters. As output and input
-       * buffers may overlap, need to use memmove
-       * instead of memcpy */
-      if (i != j)
-        {
-          memmove (&tmp[j], &tmp[i], utf8_len);
-        }
-
-      /* Update both indexes */
-      i += utf8_len;
-      j += utf8_len;
+      p = next;
     }
+  *q = '\0';
 
-  /* Force proper string end */
-  tmp[j] = '\0';
-
-  return tmp;
+  return folded;
 }
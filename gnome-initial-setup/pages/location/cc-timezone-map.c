@@ -37,31 +37,58 @@ G_DEFINE_TYPE (CcTimezoneMap, cc_timezone_map, GTK_TYPE_WIDGET)
 
 #define DATETIME_RESOURCE_PATH "/org/gnome/control-center/datetime"
 
-typedef struct
+/* Number of pre-scaled copies of each map layer shipped in the resource
+ * bundle, including the original.  Level N is 1/2^N of the original
+ * size, see map-levels.c.
+ */
+#define MAP_LEVELS 3
+
+/* timezones.png holds one value per pixel of the map: the offset id,
+ * an index into offsets[] plus one, shifted left by one, with the low
+ * bit set where the pixel is land.  Every hilight is drawn from it.
+ */
+#define OFFSET_ID(value) ((value) >> 1)
+
+static const gdouble offsets[] =
 {
-  gdouble offset;
-  guchar red;
-  guchar green;
-  guchar blue;
-  guchar alpha;
-} CcTimezoneMapOffset;
+  -11.0, -10.0, -9.5, -9.0, -8.0, -7.0, -6.0, -5.5, -5.0, -4.5,
+  -4.0, -3.5, -3.0, -2.0, -1.0, 0.0, 1.0, 2.0, 3.0, 3.5,
+  4.0, 4.5, 5.0, 5.5, 5.75, 6.0, 6.5, 7.0, 8.0, 8.75,
+  9.0, 9.5, 10.0, 10.5, 11.0, 11.5, 12.0, 12.75, 13.0, 14.0
+};
 
 struct _CcTimezoneMapPrivate
 {
-  GdkPixbuf *orig_background;
-  GdkPixbuf *orig_background_dim;
-  GdkPixbuf *orig_color_map;
+  GdkPixbuf *pin;
+
+  /* Size of the full resolution map layers */
+  gint map_width;
+  gint map_height;
 
-  GdkPixbuf *background;
-  GdkPixbuf *color_map;
+  /* Decoded map layers at each level, see get_layer_level() */
+  GHashTable *level_cache;
+  /* Layers and pin scaled for the current allocation */
+  GHashTable *surface_cache;
 
-  guchar *visible_map_pixels;
-  gint visible_map_rowstride;
+  /* Contents of timezones.png, map_width bytes per row */
+  guint8 *offset_ids;
+  /* Bounding box of each timezone in map coordinates, by id - 1 */
+  cairo_rectangle_int_t offset_bounds[G_N_ELEMENTS (offsets)];
 
   gdouble selected_offset;
 
+  /* Shared, see tz_db_get_default_async() */
   TzDB *tzdb;
+  GCancellable *cancellable;
   TzLocation *location;
+
+  /* The latest click or cc_timezone_map_set_timezone() call made while
+   * the database was loading, applied once it has arrived.  Clicks are
+   * kept as fractions of the allocation. */
+  gchar *pending_timezone;
+  gboolean pending_click;
+  gdouble pending_click_x;
+  gdouble pending_click_y;
 };
 
 enum
@@ -73,47 +100,19 @@ enum
 static guint signals[LAST_SIGNAL];
 
 
-static CcTimezoneMapOffset color_codes[] =
-{
-    {-11.0, 43, 0, 0, 255 },
-    {-10.0, 85, 0, 0, 255 },
-    {-9.5, 102, 255, 0, 255 },
-    {-9.0, 128, 0, 0, 255 },
-    {-8.0, 170, 0, 0, 255 },
-    {-7.0, 212, 0, 0, 255 },
-    {-6.0, 255, 0, 1, 255 }, // north
-    {-6.0, 255, 0, 0, 255 }, // south
-    {-5.0, 255, 42, 42, 255 },
-    {-4.5, 192, 255, 0, 255 },
-    {-4.0, 255, 85, 85, 255 },
-    {-3.5, 0, 255, 0, 255 },
-    {-3.0, 255, 128, 128, 255 },
-    {-2.0, 255, 170, 170, 255 },
-    {-1.0, 255, 213, 213, 255 },
-    {0.0, 43, 17, 0, 255 },
-    {1.0, 85, 34, 0, 255 },
-    {2.0, 128, 51, 0, 255 },
-    {3.0, 170, 68, 0, 255 },
-    {3.5, 0, 255, 102, 255 },
-    {4.0, 212, 85, 0, 255 },
-    {4.5, 0, 204, 255, 255 },
-    {5.0, 255, 102, 0, 255 },
-    {5.5, 0, 102, 255, 255 },
-    {5.75, 0, 238, 207, 247 },
-    {6.0, 255, 127, 42, 255 },
-    {6.5, 204, 0, 254, 254 },
-    {7.0, 255, 153, 85, 255 },
-    {8.0, 255, 179, 128, 255 },
-    {9.0, 255, 204, 170, 255 },
-    {9.5, 170, 0, 68, 250 },
-    {10.0, 255, 230, 213, 255 },
-    {10.5, 212, 124, 21, 250 },
-    {11.0, 212, 170, 0, 255 },
-    {11.5, 249, 25, 87, 253 },
-    {12.0, 255, 204, 0, 255 },
-    {12.75, 254, 74, 100, 248 },
-    {13.0, 255, 85, 153, 250 },
-    {-100, 0, 0, 0, 0 }
+typedef struct
+{
+  gdouble red;
+  gdouble green;
+  gdouble blue;
+  gdouble alpha;
+} CcTimezoneMapColor;
+
+/* Hilight colours for the sea and the land part of a timezone */
+static const CcTimezoneMapColor hilight_colors[] =
+{
+  { 62 / 255.0, 115 / 255.0, 197 / 255.0, 109 / 255.0 },
+  { 140 / 255.0, 206 / 255.0, 85 / 255.0, 1.0 }
 };
 
 
@@ -148,29 +147,15 @@ cc_timezone_map_dispose (GObject *object)
 {
   CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (object)->priv;
 
-  g_clear_object (&priv->orig_background);
-  g_clear_object (&priv->orig_background_dim);
-
-  if (priv->orig_color_map)
+  if (priv->cancellable)
     {
-      g_object_unref (priv->orig_color_map);
-      priv->orig_color_map = NULL;
+      g_cancellable_cancel (priv->cancellable);
+      g_clear_object (&priv->cancellable);
     }
 
-  if (priv->background)
-    {
-      g_object_unref (priv->background);
-      priv->background = NULL;
-    }
-
-  if (priv->color_map)
-    {
-      g_object_unref (priv->color_map);
-      priv->color_map = NULL;
-
-      priv->visible_map_pixels = NULL;
-      priv->visible_map_rowstride = 0;
-    }
+  g_clear_object (&priv->pin);
+  g_clear_pointer (&priv->level_cache, g_hash_table_destroy);
+  g_clear_pointer (&priv->surface_cache, g_hash_table_destroy);
 
   G_OBJECT_CLASS (cc_timezone_map_parent_class)->dispose (object);
 }
@@ -180,12 +165,9 @@ cc_timezone_map_finalize (GObject *object)
 {
   CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (object)->priv;
 
-  if (priv->tzdb)
-    {
-      tz_db_free (priv->tzdb);
-      priv->tzdb = NULL;
-    }
-
+  g_clear_pointer (&priv->tzdb, tz_db_unref);
+  g_clear_pointer (&priv->offset_ids, g_free);
+  g_clear_pointer (&priv->pending_timezone, g_free);
 
   G_OBJECT_CLASS (cc_timezone_map_parent_class)->finalize (object);
 }
@@ -216,7 +198,7 @@ cc_timezone_map_get_preferred_height (GtkWidget *widget,
   /* The + 20 here is a slight tweak to make the map fill the
    * panel better without causing horizontal growing
    */
-  size = 300 * gdk_pixbuf_get_height (priv->orig_background) / gdk_pixbuf_get_width (priv->orig_background) + 20;
+  size = 300 * priv->map_height / priv->map_width + 20;
   if (minimum != NULL)
     *minimum = size;
   if (natural != NULL)
@@ -228,31 +210,9 @@ cc_timezone_map_size_allocate (GtkWidget     *widget,
                                GtkAllocation *allocation)
 {
   CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
-  GdkPixbuf *pixbuf;
-
-  if (priv->background)
-    g_object_unref (priv->background);
-
-  if (!gtk_widget_is_sensitive (widget))
-    pixbuf = priv->orig_background_dim;
-  else
-    pixbuf = priv->orig_background;
-
-  priv->background = gdk_pixbuf_scale_simple (pixbuf,
-                                              allocation->width,
-                                              allocation->height,
-                                              GDK_INTERP_BILINEAR);
-
-  if (priv->color_map)
-    g_object_unref (priv->color_map);
 
-  priv->color_map = gdk_pixbuf_scale_simple (priv->orig_color_map,
-                                             allocation->width,
-                                             allocation->height,
-                                             GDK_INTERP_BILINEAR);
-
-  priv->visible_map_pixels = gdk_pixbuf_get_pixels (priv->color_map);
-  priv->visible_map_rowstride = gdk_pixbuf_get_rowstride (priv->color_map);
+  /* Everything in the cache was scaled for the old allocation */
+  g_hash_table_remove_all (priv->surface_cache);
 
   GTK_WIDGET_CLASS (cc_timezone_map_parent_class)->size_allocate (widget,
                                                                   allocation);
@@ -323,84 +283,437 @@ convert_latitude_to_y (gdouble latitude, gdouble map_height)
 }
 
 
-static gboolean
-cc_timezone_map_draw (GtkWidget *widget,
-                      cairo_t   *cr)
+static cairo_surface_t *
+create_similar_surface_for_pixbuf (cairo_t   *cr,
+                                   GdkPixbuf *pixbuf)
 {
-  CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
-  GdkPixbuf *hilight, *orig_hilight, *pin;
-  GtkAllocation alloc;
-  gchar *file;
-  GError *err = NULL;
-  gdouble pointx, pointy;
-  char buf[16];
-  const char *fmt;
+  cairo_surface_t *surface;
+  cairo_t *surface_cr;
 
-  gtk_widget_get_allocation (widget, &alloc);
+  surface = cairo_surface_create_similar (cairo_get_target (cr),
+                                          CAIRO_CONTENT_COLOR_ALPHA,
+                                          gdk_pixbuf_get_width (pixbuf),
+                                          gdk_pixbuf_get_height (pixbuf));
 
-  /* paint background */
-  gdk_cairo_set_source_pixbuf (cr, priv->background, 0, 0);
-  cairo_paint (cr);
+  surface_cr = cairo_create (surface);
+  gdk_cairo_set_source_pixbuf (surface_cr, pixbuf, 0, 0);
+  cairo_paint (surface_cr);
+  cairo_destroy (surface_cr);
 
-  /* paint hilight */
-  if (gtk_widget_is_sensitive (widget))
-    fmt = DATETIME_RESOURCE_PATH "/timezone_%s.png";
+  return surface;
+}
+
+/* Returns the decoded layer @name at @level, owned by the level
+ * cache, or NULL if it could not be loaded.
+ */
+static cairo_surface_t *
+get_layer_level (CcTimezoneMap *map,
+                 const gchar   *name,
+                 gint           level)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  cairo_surface_t *surface;
+  GdkPixbuf *pixbuf;
+  GError *err = NULL;
+  gchar *key;
+  gchar *file;
+
+  key = g_strdup_printf ("%s:%d", name, level);
+  surface = g_hash_table_lookup (priv->level_cache, key);
+  if (surface)
+    {
+      g_free (key);
+      return surface;
+    }
+
+  if (level == 0)
+    file = g_strdup_printf (DATETIME_RESOURCE_PATH "/%s.png", name);
   else
-    fmt = DATETIME_RESOURCE_PATH "/timezone_%s_dim.png";
+    file = g_strdup_printf (DATETIME_RESOURCE_PATH "/level%d/%s.png", level, name);
+
+  pixbuf = gdk_pixbuf_new_from_resource (file, &err);
+  if (!pixbuf)
+    {
+      g_warning ("Could not load %s: %s", file,
+                 (err) ? err->message : "Unknown Error");
+      g_clear_error (&err);
+      g_free (file);
+      g_free (key);
+      return NULL;
+    }
+
+  surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, 1, NULL);
+  g_hash_table_insert (priv->level_cache, key, surface);
 
-  file = g_strdup_printf (fmt,
-                          g_ascii_formatd (buf, sizeof (buf),
-                                           "%g", priv->selected_offset));
-  orig_hilight = gdk_pixbuf_new_from_resource (file, &err);
+  g_object_unref (pixbuf);
   g_free (file);
-  file = NULL;
 
-  if (!orig_hilight)
+  return surface;
+}
+
+/* Returns a surface, owned by the cache, holding the layer @name scaled
+ * to @width x @height, or NULL if the layer could not be loaded.  The
+ * scaling starts from the smallest shipped level that is still at least
+ * as large as the target, and only happens the first time a given
+ * (layer, size, scale) combination is drawn; the cache is emptied on
+ * size-allocate.
+ */
+static cairo_surface_t *
+get_cached_layer (CcTimezoneMap *map,
+                  cairo_t       *cr,
+                  const gchar   *name,
+                  gint           width,
+                  gint           height)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  cairo_surface_t *surface, *source;
+  cairo_t *surface_cr;
+  gint scale, level;
+  gchar *key;
+
+  scale = gtk_widget_get_scale_factor (GTK_WIDGET (map));
+
+  key = g_strdup_printf ("%s:%dx%d@%d", name, width, height, scale);
+  surface = g_hash_table_lookup (priv->surface_cache, key);
+  if (surface)
     {
-      g_warning ("Could not load hilight: %s",
-                 (err) ? err->message : "Unknown Error");
-      if (err)
-        g_clear_error (&err);
+      g_free (key);
+      return surface;
     }
-  else
+
+  for (level = MAP_LEVELS - 1; level > 0; level--)
     {
+      if ((priv->map_width >> level) >= width * scale &&
+          (priv->map_height >> level) >= height * scale)
+        break;
+    }
 
-      hilight = gdk_pixbuf_scale_simple (orig_hilight, alloc.width,
-                                         alloc.height, GDK_INTERP_BILINEAR);
-      gdk_cairo_set_source_pixbuf (cr, hilight, 0, 0);
+  source = get_layer_level (map, name, level);
+  if (!source)
+    {
+      g_free (key);
+      return NULL;
+    }
 
-      cairo_paint (cr);
-      g_object_unref (hilight);
-      g_object_unref (orig_hilight);
+  surface = cairo_surface_create_similar (cairo_get_target (cr),
+                                          CAIRO_CONTENT_COLOR_ALPHA,
+                                          width, height);
+
+  surface_cr = cairo_create (surface);
+  cairo_scale (surface_cr,
+               (gdouble) width / cairo_image_surface_get_width (source),
+               (gdouble) height / cairo_image_surface_get_height (source));
+  cairo_set_source_surface (surface_cr, source, 0, 0);
+  cairo_pattern_set_filter (cairo_get_source (surface_cr), CAIRO_FILTER_GOOD);
+  cairo_paint (surface_cr);
+  cairo_destroy (surface_cr);
+
+  g_hash_table_insert (priv->surface_cache, key, surface);
+
+  return surface;
+}
+
+static guint
+offset_to_id (gdouble offset)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (offsets); i++)
+    {
+      if (offsets[i] == offset)
+        return i + 1;
     }
 
-  /* load pin icon */
-  pin = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/pin.png", &err);
+  return 0;
+}
 
-  if (err)
+/* Returns a new full resolution A8 mask covering the land or the sea
+ * part of the timezone @id.  The masks are not kept: they are only
+ * needed to build a hilight, which get_cached_hilight() caches at the
+ * allocated size.
+ */
+static cairo_surface_t *
+create_hilight_mask (CcTimezoneMap *map,
+                     guint          id,
+                     gboolean       land)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  const cairo_rectangle_int_t *bounds = &priv->offset_bounds[id - 1];
+  cairo_surface_t *surface;
+  guchar *data;
+  guint8 value;
+  gint stride;
+  gint x, y;
+
+  /* Starts out cleared, so only the bounds of the timezone are filled */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_A8,
+                                        priv->map_width, priv->map_height);
+  cairo_surface_flush (surface);
+
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+  value = (id << 1) | (land ? 1 : 0);
+
+  for (y = bounds->y; y < bounds->y + bounds->height; y++)
     {
-      g_warning ("Could not load pin icon: %s", err->message);
-      g_clear_error (&err);
+      const guint8 *ids = priv->offset_ids + y * priv->map_width;
+
+      for (x = bounds->x; x < bounds->x + bounds->width; x++)
+        data[y * stride + x] = (ids[x] == value) ? 0xff : 0;
     }
 
-  if (priv->location)
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
+static void
+mask_scaled (cairo_t         *cr,
+             cairo_surface_t *mask)
+{
+  cairo_pattern_t *pattern;
+
+  pattern = cairo_pattern_create_for_surface (mask);
+  cairo_pattern_set_filter (pattern, CAIRO_FILTER_GOOD);
+  cairo_mask (cr, pattern);
+  cairo_pattern_destroy (pattern);
+}
+
+/* Returns a surface, owned by the cache, holding the hilight for the
+ * selected offset scaled to @width x @height, or NULL if there is
+ * nothing to hilight.  Each part is filled through its mask; the
+ * insensitive variant is the same fill desaturated with the
+ * HSL_SATURATION operator.
+ */
+static cairo_surface_t *
+get_cached_hilight (CcTimezoneMap *map,
+                    cairo_t       *cr,
+                    gint           width,
+                    gint           height)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GtkWidget *widget = GTK_WIDGET (map);
+  cairo_surface_t *surface;
+  cairo_t *surface_cr;
+  gboolean sensitive;
+  guint id;
+  guint land;
+  gchar *key;
+
+  if (!priv->offset_ids)
+    return NULL;
+
+  id = offset_to_id (priv->selected_offset);
+  if (id == 0)
+    return NULL;
+
+  sensitive = gtk_widget_is_sensitive (widget);
+
+  key = g_strdup_printf ("hilight:%u:%dx%d:%d@%d", id, width, height,
+                         sensitive, gtk_widget_get_scale_factor (widget));
+  surface = g_hash_table_lookup (priv->surface_cache, key);
+  if (surface)
     {
-      pointx = convert_longtitude_to_x (priv->location->longitude, alloc.width);
-      pointy = convert_latitude_to_y (priv->location->latitude, alloc.height);
+      g_free (key);
+      return surface;
+    }
 
-      if (pointy > alloc.height)
-        pointy = alloc.height;
+  surface = cairo_surface_create_similar (cairo_get_target (cr),
+                                          CAIRO_CONTENT_COLOR_ALPHA,
+                                          width, height);
 
-      if (pin)
+  surface_cr = cairo_create (surface);
+  cairo_scale (surface_cr,
+               (gdouble) width / priv->map_width,
+               (gdouble) height / priv->map_height);
+
+  for (land = 0; land < G_N_ELEMENTS (hilight_colors); land++)
+    {
+      const CcTimezoneMapColor *color = &hilight_colors[land];
+      cairo_surface_t *mask = create_hilight_mask (map, id, land);
+
+      cairo_push_group (surface_cr);
+
+      cairo_set_source_rgb (surface_cr, color->red, color->green, color->blue);
+      mask_scaled (surface_cr, mask);
+
+      if (!sensitive)
         {
-          gdk_cairo_set_source_pixbuf (cr, pin, pointx - PIN_HOT_POINT_X, pointy - PIN_HOT_POINT_Y);
-          cairo_paint (cr);
+          cairo_set_operator (surface_cr, CAIRO_OPERATOR_HSL_SATURATION);
+          cairo_set_source_rgb (surface_cr, 0.5, 0.5, 0.5);
+          mask_scaled (surface_cr, mask);
+          cairo_set_operator (surface_cr, CAIRO_OPERATOR_OVER);
         }
+
+      cairo_pop_group_to_source (surface_cr);
+      cairo_paint_with_alpha (surface_cr, color->alpha);
+
+      cairo_surface_destroy (mask);
     }
 
-  if (pin)
+  cairo_destroy (surface_cr);
+
+  g_hash_table_insert (priv->surface_cache, key, surface);
+
+  return surface;
+}
+
+static cairo_surface_t *
+get_cached_pin (CcTimezoneMap *map,
+                cairo_t       *cr)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  cairo_surface_t *surface;
+  gchar *key;
+
+  if (!priv->pin)
+    return NULL;
+
+  key = g_strdup_printf ("pin:%d", gtk_widget_get_scale_factor (GTK_WIDGET (map)));
+  surface = g_hash_table_lookup (priv->surface_cache, key);
+  if (surface)
     {
-      g_object_unref (pin);
+      g_free (key);
+      return surface;
+    }
+
+  surface = create_similar_surface_for_pixbuf (cr, priv->pin);
+  g_hash_table_insert (priv->surface_cache, key, surface);
+
+  return surface;
+}
+
+static void
+get_map_rect_in_widget (CcTimezoneMap               *map,
+                        const cairo_rectangle_int_t *map_rect,
+                        GdkRectangle                *rect)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GtkAllocation alloc;
+  gint x1, y1, x2, y2;
+
+  gtk_widget_get_allocation (GTK_WIDGET (map), &alloc);
+
+  /* round outwards, with a pixel to spare for the scaling filter */
+  x1 = floor ((gdouble) map_rect->x * alloc.width / priv->map_width) - 1;
+  y1 = floor ((gdouble) map_rect->y * alloc.height / priv->map_height) - 1;
+  x2 = ceil ((gdouble) (map_rect->x + map_rect->width) * alloc.width / priv->map_width) + 1;
+  y2 = ceil ((gdouble) (map_rect->y + map_rect->height) * alloc.height / priv->map_height) + 1;
+
+  rect->x = x1;
+  rect->y = y1;
+  rect->width = x2 - x1;
+  rect->height = y2 - y1;
+}
+
+/* Returns FALSE if nothing is hilighted */
+static gboolean
+get_hilight_rect (CcTimezoneMap *map,
+                  GdkRectangle  *rect)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  guint id;
+
+  id = offset_to_id (priv->selected_offset);
+  if (id == 0 || priv->offset_bounds[id - 1].width == 0)
+    return FALSE;
+
+  get_map_rect_in_widget (map, &priv->offset_bounds[id - 1], rect);
+
+  return TRUE;
+}
+
+static void
+get_pin_position (CcTimezoneMap *map,
+                  gdouble       *pointx,
+                  gdouble       *pointy)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GtkAllocation alloc;
+
+  gtk_widget_get_allocation (GTK_WIDGET (map), &alloc);
+
+  *pointx = convert_longtitude_to_x (priv->location->longitude, alloc.width);
+  *pointy = convert_latitude_to_y (priv->location->latitude, alloc.height);
+
+  if (*pointy > alloc.height)
+    *pointy = alloc.height;
+}
+
+/* Queues a redraw of the parts of the map that change along with the
+ * selection: the hilight and the pin.  Called both before and after
+ * the selection changes.
+ */
+static void
+queue_draw_selection (CcTimezoneMap *map)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GtkWidget *widget = GTK_WIDGET (map);
+  GdkRectangle rect;
+
+  if (get_hilight_rect (map, &rect))
+    gtk_widget_queue_draw_area (widget, rect.x, rect.y, rect.width, rect.height);
+
+  if (priv->location)
+    {
+      gdouble pointx, pointy;
+      gint pin_width, pin_height;
+
+      get_pin_position (map, &pointx, &pointy);
+
+      pin_width = priv->pin ? gdk_pixbuf_get_width (priv->pin) : 0;
+      pin_height = priv->pin ? gdk_pixbuf_get_height (priv->pin) : 0;
+
+      gtk_widget_queue_draw_area (widget,
+                                  floor (pointx) - PIN_HOT_POINT_X - 1,
+                                  floor (pointy) - PIN_HOT_POINT_Y - 1,
+                                  pin_width + 2, pin_height + 2);
+    }
+}
+
+static gboolean
+cc_timezone_map_draw (GtkWidget *widget,
+                      cairo_t   *cr)
+{
+  CcTimezoneMap *map = CC_TIMEZONE_MAP (widget);
+  CcTimezoneMapPrivate *priv = map->priv;
+  cairo_surface_t *background, *hilight, *pin;
+  GtkAllocation alloc;
+  GdkRectangle rect;
+  gdouble pointx, pointy;
+  gboolean sensitive;
+
+  gtk_widget_get_allocation (widget, &alloc);
+  sensitive = gtk_widget_is_sensitive (widget);
+
+  /* paint background */
+  background = get_cached_layer (map, cr, sensitive ? "bg" : "bg_dim",
+                                 alloc.width, alloc.height);
+  if (background)
+    {
+      cairo_set_source_surface (cr, background, 0, 0);
+      cairo_paint (cr);
+    }
+
+  /* paint hilight, which only covers its own timezone */
+  hilight = get_cached_hilight (map, cr, alloc.width, alloc.height);
+  if (hilight && get_hilight_rect (map, &rect))
+    {
+      cairo_set_source_surface (cr, hilight, 0, 0);
+      gdk_cairo_rectangle (cr, &rect);
+      cairo_fill (cr);
+    }
+
+  if (priv->location)
+    {
+      get_pin_position (map, &pointx, &pointy);
+
+      pin = get_cached_pin (map, cr);
+      if (pin)
+        {
+          cairo_set_source_surface (cr, pin, pointx - PIN_HOT_POINT_X, pointy - PIN_HOT_POINT_Y);
+          cairo_paint (cr);
+        }
     }
 
   return TRUE;
@@ -472,17 +785,16 @@ cc_timezone_map_class_init (CcTimezoneMapClass *klass)
 }
 
 
-static gint
-sort_locations (TzLocation *a,
-                TzLocation *b)
+/* The database may still be loading when the widget is first used */
+static TzDB *
+get_tzdb (CcTimezoneMap *map)
 {
-  if (a->dist > b->dist)
-    return 1;
+  CcTimezoneMapPrivate *priv = map->priv;
 
-  if (a->dist < b->dist)
-    return -1;
+  if (!priv->tzdb)
+    priv->tzdb = tz_db_get_default ();
 
-  return 0;
+  return priv->tzdb;
 }
 
 static void
@@ -492,6 +804,8 @@ set_location (CcTimezoneMap *map,
   CcTimezoneMapPrivate *priv = map->priv;
   TzInfo *info;
 
+  queue_draw_selection (map);
+
   priv->location = location;
 
   info = tz_info_from_location (priv->location);
@@ -499,122 +813,299 @@ set_location (CcTimezoneMap *map,
   priv->selected_offset = tz_location_get_utc_offset (priv->location)
     / (60.0*60.0) + ((info->daylight) ? -1.0 : 0.0);
 
+  queue_draw_selection (map);
+
   g_signal_emit (map, signals[LOCATION_CHANGED], 0, priv->location);
 
   tz_info_free (info);
 }
 
+static void
+select_nearest_location (CcTimezoneMap *map,
+                         gint           x,
+                         gint           y,
+                         gint           width,
+                         gint           height)
+{
+  const GPtrArray *array;
+  TzLocation *closest = NULL;
+  gdouble closest_dist = G_MAXDOUBLE;
+  guint i;
+
+  /* work out the co-ordinates */
+
+  array = tz_get_locations (map->priv->tzdb);
+
+  for (i = 0; i < array->len; i++)
+    {
+      gdouble pointx, pointy, dx, dy, dist;
+      TzLocation *loc = array->pdata[i];
+
+      pointx = convert_longtitude_to_x (loc->longitude, width);
+      pointy = convert_latitude_to_y (loc->latitude, height);
+
+      dx = pointx - x;
+      dy = pointy - y;
+
+      dist = dx * dx + dy * dy;
+      if (dist < closest_dist)
+        {
+          closest = loc;
+          closest_dist = dist;
+        }
+    }
+
+  if (closest)
+    set_location (map, closest);
+}
+
 static gboolean
 button_press_event (GtkWidget      *widget,
                     GdkEventButton *event)
 {
   CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
   gint x, y;
-  guchar r, g, b, a;
-  guchar *pixels;
-  gint rowstride;
-  gint i;
-
-  const GPtrArray *array;
+  gint map_x, map_y;
   gint width, height;
-  GList *distances = NULL;
   GtkAllocation alloc;
 
   x = event->x;
   y = event->y;
 
+  gtk_widget_get_allocation (widget, &alloc);
+  width = alloc.width;
+  height = alloc.height;
 
-  rowstride = priv->visible_map_rowstride;
-  pixels = priv->visible_map_pixels;
+  /* look up the offset in the full resolution map, so that the result
+   * does not depend on how the map is scaled */
+  if (priv->offset_ids && width > 0 && height > 0)
+    {
+      guint id;
 
-  r = pixels[(rowstride * y + x * 4)];
-  g = pixels[(rowstride * y + x * 4) + 1];
-  b = pixels[(rowstride * y + x * 4) + 2];
-  a = pixels[(rowstride * y + x * 4) + 3];
+      map_x = CLAMP (x * priv->map_width / width, 0, priv->map_width - 1);
+      map_y = CLAMP (y * priv->map_height / height, 0, priv->map_height - 1);
 
+      id = OFFSET_ID (priv->offset_ids[map_y * priv->map_width + map_x]);
+      if (id > 0 && id <= G_N_ELEMENTS (offsets))
+        {
+          queue_draw_selection (CC_TIMEZONE_MAP (widget));
+          priv->selected_offset = offsets[id - 1];
+          queue_draw_selection (CC_TIMEZONE_MAP (widget));
+        }
+    }
 
-  for (i = 0; color_codes[i].offset != -100; i++)
+  if (!get_tzdb (CC_TIMEZONE_MAP (widget)))
     {
-       if (color_codes[i].red == r && color_codes[i].green == g
-           && color_codes[i].blue == b && color_codes[i].alpha == a)
-         {
-           priv->selected_offset = color_codes[i].offset;
-         }
+      g_clear_pointer (&priv->pending_timezone, g_free);
+      priv->pending_click = TRUE;
+      priv->pending_click_x = (gdouble) x / MAX (width, 1);
+      priv->pending_click_y = (gdouble) y / MAX (height, 1);
+      return TRUE;
     }
 
-  gtk_widget_queue_draw (widget);
+  select_nearest_location (CC_TIMEZONE_MAP (widget), x, y, width, height);
 
-  /* work out the co-ordinates */
+  return TRUE;
+}
 
-  array = tz_get_locations (priv->tzdb);
+/* Unpacks timezones.png into one byte per pixel */
+static guint8 *
+create_offset_ids (GdkPixbuf *pixbuf,
+                   gint       width,
+                   gint       height)
+{
+  guint8 *offset_ids;
+  const guchar *pixels;
+  gint rowstride, n_channels;
+  gint x, y;
 
-  gtk_widget_get_allocation (widget, &alloc);
-  width = alloc.width;
-  height = alloc.height;
+  if (gdk_pixbuf_get_width (pixbuf) != width ||
+      gdk_pixbuf_get_height (pixbuf) != height)
+    {
+      g_warning ("Timezone index does not match the background size");
+      return NULL;
+    }
 
-  for (i = 0; i < array->len; i++)
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+  offset_ids = g_new (guint8, width * height);
+
+  for (y = 0; y < height; y++)
     {
-      gdouble pointx, pointy, dx, dy;
-      TzLocation *loc = array->pdata[i];
+      const guchar *p = pixels + y * rowstride;
 
-      pointx = convert_longtitude_to_x (loc->longitude, width);
-      pointy = convert_latitude_to_y (loc->latitude, height);
+      for (x = 0; x < width; x++, p += n_channels)
+        offset_ids[y * width + x] = p[0];
+    }
 
-      dx = pointx - x;
-      dy = pointy - y;
+  return offset_ids;
+}
 
-      loc->dist = dx * dx + dy * dy;
-      distances = g_list_prepend (distances, loc);
+static void
+compute_offset_bounds (CcTimezoneMapPrivate *priv)
+{
+  gint x1[G_N_ELEMENTS (offsets)], y1[G_N_ELEMENTS (offsets)];
+  gint x2[G_N_ELEMENTS (offsets)], y2[G_N_ELEMENTS (offsets)];
+  guint i;
+  gint x, y;
 
+  for (i = 0; i < G_N_ELEMENTS (offsets); i++)
+    {
+      x1[i] = y1[i] = G_MAXINT;
+      x2[i] = y2[i] = -1;
     }
-  distances = g_list_sort (distances, (GCompareFunc) sort_locations);
 
+  for (y = 0; y < priv->map_height; y++)
+    {
+      const guint8 *ids = priv->offset_ids + y * priv->map_width;
 
-  set_location (CC_TIMEZONE_MAP (widget), (TzLocation*) distances->data);
+      for (x = 0; x < priv->map_width; x++)
+        {
+          guint id = OFFSET_ID (ids[x]);
 
-  g_list_free (distances);
+          if (id == 0 || id > G_N_ELEMENTS (offsets))
+            continue;
 
-  return TRUE;
+          i = id - 1;
+          x1[i] = MIN (x1[i], x);
+          y1[i] = MIN (y1[i], y);
+          x2[i] = MAX (x2[i], x);
+          y2[i] = MAX (y2[i], y);
+        }
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (offsets); i++)
+    {
+      cairo_rectangle_int_t *bounds = &priv->offset_bounds[i];
+
+      if (x2[i] < 0)
+        {
+          bounds->x = bounds->y = bounds->width = bounds->height = 0;
+          continue;
+        }
+
+      bounds->x = x1[i];
+      bounds->y = y1[i];
+      bounds->width = x2[i] - x1[i] + 1;
+      bounds->height = y2[i] - y1[i] + 1;
+    }
+}
+
+static void
+apply_pending (CcTimezoneMap *map)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GtkAllocation alloc;
+  gchar *timezone;
+
+  if (priv->pending_timezone)
+    {
+      timezone = priv->pending_timezone;
+      priv->pending_timezone = NULL;
+      if (!cc_timezone_map_set_timezone (map, timezone))
+        g_warning ("Unknown timezone %s", timezone);
+      g_free (timezone);
+    }
+  else if (priv->pending_click)
+    {
+      priv->pending_click = FALSE;
+      gtk_widget_get_allocation (GTK_WIDGET (map), &alloc);
+      select_nearest_location (map,
+                               priv->pending_click_x * alloc.width,
+                               priv->pending_click_y * alloc.height,
+                               alloc.width, alloc.height);
+    }
+}
+
+static void
+tzdb_ready_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  CcTimezoneMap *map;
+  TzDB *tzdb;
+  GError *error = NULL;
+
+  tzdb = tz_db_get_default_finish (result, &error);
+  if (!tzdb)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Could not load timezone database: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  map = CC_TIMEZONE_MAP (user_data);
+
+  if (!map->priv->tzdb)
+    map->priv->tzdb = tzdb;
+  else
+    tz_db_unref (tzdb);
+
+  apply_pending (map);
 }
 
 static void
 cc_timezone_map_init (CcTimezoneMap *self)
 {
   CcTimezoneMapPrivate *priv;
+  cairo_surface_t *background;
+  GdkPixbuf *index_pixbuf;
   GError *err = NULL;
 
   priv = self->priv = TIMEZONE_MAP_PRIVATE (self);
 
-  priv->orig_background = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/bg.png",
-                                                        &err);
+  priv->level_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free,
+                                             (GDestroyNotify) cairo_surface_destroy);
+  priv->surface_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify) cairo_surface_destroy);
 
-  if (!priv->orig_background)
+  /* The full resolution background is needed for sizing anyway, and
+   * is what large allocations scale from.
+   */
+  background = get_layer_level (self, "bg", 0);
+  if (background)
     {
-      g_warning ("Could not load background image: %s",
-                 (err) ? err->message : "Unknown error");
-      g_clear_error (&err);
+      priv->map_width = cairo_image_surface_get_width (background);
+      priv->map_height = cairo_image_surface_get_height (background);
+    }
+  else
+    {
+      priv->map_width = 800;
+      priv->map_height = 409;
     }
 
-  priv->orig_background_dim = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/bg_dim.png",
-                                                            &err);
-
-  if (!priv->orig_background_dim)
+  index_pixbuf = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/timezones.png",
+                                               &err);
+  if (!index_pixbuf)
     {
-      g_warning ("Could not load background image: %s",
+      g_warning ("Could not load timezone index: %s",
                  (err) ? err->message : "Unknown error");
       g_clear_error (&err);
     }
+  else
+    {
+      priv->offset_ids = create_offset_ids (index_pixbuf, priv->map_width, priv->map_height);
+      if (priv->offset_ids)
+        compute_offset_bounds (priv);
+      g_object_unref (index_pixbuf);
+    }
 
-  priv->orig_color_map = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/cc.png",
-                                                       &err);
-  if (!priv->orig_color_map)
+  priv->pin = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/pin.png",
+                                            &err);
+  if (!priv->pin)
     {
-      g_warning ("Could not load background image: %s",
+      g_warning ("Could not load pin icon: %s",
                  (err) ? err->message : "Unknown error");
       g_clear_error (&err);
     }
 
-  priv->tzdb = tz_load_db ();
+  priv->cancellable = g_cancellable_new ();
+  tz_db_get_default_async (priv->cancellable, tzdb_ready_cb, self);
 
   g_signal_connect (self, "button-press-event", G_CALLBACK (button_press_event),
                     NULL);
@@ -635,6 +1126,15 @@ cc_timezone_map_set_timezone (CcTimezoneMap *map,
   char *real_tz;
   gboolean ret;
 
+  if (!get_tzdb (map))
+    {
+      /* Can't be checked yet; apply_pending() warns if it is unknown */
+      g_free (map->priv->pending_timezone);
+      map->priv->pending_timezone = g_strdup (timezone);
+      map->priv->pending_click = FALSE;
+      return TRUE;
+    }
+
   real_tz = tz_info_get_clean_name (map->priv->tzdb, timezone);
 
   locations = tz_get_locations (map->priv->tzdb);
@@ -652,9 +1152,6 @@ cc_timezone_map_set_timezone (CcTimezoneMap *map,
         }
     }
 
-  if (ret)
-    gtk_widget_queue_draw (GTK_WIDGET (map));
-
   g_free (real_tz);
 
   return ret;
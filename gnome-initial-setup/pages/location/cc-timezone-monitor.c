@@ -49,7 +49,10 @@ typedef struct
         GeoclueManager *geoclue_manager;
 
         TzDB *tzdb;
-        WeatherTzDB *weather_tzdb;
+        WeatherTzDB *weather_tzdb;      /* shared */
+        /* Databases still loading, and the place waiting for them */
+        guint pending_dbs;
+        GeocodePlace *pending_place;
 
         gulong on_location_updated_id;
 } CcTimezoneMonitorPrivate;
@@ -57,37 +60,32 @@ typedef struct
 #define GET_PRIVATE(object) (G_TYPE_INSTANCE_GET_PRIVATE((object), CC_TYPE_TIMEZONE_MONITOR, CcTimezoneMonitorPrivate))
 G_DEFINE_TYPE (CcTimezoneMonitor, cc_timezone_monitor, G_TYPE_OBJECT)
 
-static gint
-compare_locations (TzLocation *a,
-                   TzLocation *b)
-{
-        if (a->dist > b->dist)
-                return 1;
-
-        if (a->dist < b->dist)
-                return -1;
-
-        return 0;
-}
-
-static GList *
-sort_by_closest_to (GList           *locations,
-                    GeocodeLocation *location)
+static TzLocation *
+find_closest_to (GList           *locations,
+                 GeocodeLocation *location)
 {
         GList *l;
+        TzLocation *closest = NULL;
+        gdouble closest_dist = G_MAXDOUBLE;
 
         for (l = locations; l; l = l->next) {
                 GeocodeLocation *loc;
                 TzLocation *tz_location = l->data;
+                gdouble dist;
 
                 loc = geocode_location_new (tz_location->latitude,
                                             tz_location->longitude,
                                             GEOCODE_LOCATION_ACCURACY_UNKNOWN);
-                tz_location->dist = geocode_location_get_distance_from (loc, location);
+                dist = geocode_location_get_distance_from (loc, location);
                 g_object_unref (loc);
+
+                if (dist < closest_dist) {
+                        closest = tz_location;
+                        closest_dist = dist;
+                }
         }
 
-        return g_list_sort (locations, (GCompareFunc) compare_locations);
+        return closest;
 }
 
 static GList *
@@ -131,17 +129,19 @@ find_tzlocation (CcTimezoneMonitor  *self,
                  const gchar        *country_code)
 {
         GList *filtered;
-        GList *locations;
+        GList *locations = NULL;
         CcTimezoneMonitorPrivate *priv = GET_PRIVATE (self);
         TzLocation *closest_tz_location;
 
-        /* First load locations from Olson DB */
-        locations = ptr_array_to_list (tz_get_locations (priv->tzdb));
-        g_return_val_if_fail (locations != NULL, NULL);
+        /* First load locations from Olson DB... */
+        if (priv->tzdb != NULL)
+                locations = ptr_array_to_list (tz_get_locations (priv->tzdb));
 
         /* ... and then add libgweather's locations as well */
-        locations = g_list_concat (locations,
-                                   weather_tz_db_get_locations (priv->weather_tzdb));
+        if (priv->weather_tzdb != NULL)
+                locations = g_list_concat (locations,
+                                           weather_tz_db_get_locations (priv->weather_tzdb));
+        g_return_val_if_fail (locations != NULL, NULL);
 
         /* Filter tz locations by country */
         filtered = find_by_country (locations, country_code);
@@ -153,8 +153,7 @@ find_tzlocation (CcTimezoneMonitor  *self,
         }
 
         /* Find the closest tz location */
-        locations = sort_by_closest_to (locations, location);
-        closest_tz_location = (TzLocation *) locations->data;
+        closest_tz_location = find_closest_to (locations, location);
 
         g_list_free (locations);
 
@@ -165,14 +164,24 @@ static void
 process_location (CcTimezoneMonitor *self,
                   GeocodePlace       *place)
 {
+        CcTimezoneMonitorPrivate *priv = GET_PRIVATE (self);
         GeocodeLocation *location;
         TzLocation *new_tzlocation;
         const gchar *country_code;
 
+        /* Searching only one of the databases could give a different
+         * answer; wait until both have loaded */
+        if (priv->pending_dbs > 0) {
+                g_set_object (&priv->pending_place, place);
+                return;
+        }
+
         country_code = geocode_place_get_country_code (place);
         location = geocode_place_get_location (place);
 
         new_tzlocation = find_tzlocation (self, location, country_code);
+        if (new_tzlocation == NULL)
+                return;
 
         g_signal_emit (G_OBJECT (self),
                        signals[TIMEZONE_CHANGED],
@@ -425,8 +434,8 @@ cc_timezone_monitor_finalize (GObject *obj)
 
         g_clear_object (&priv->geoclue_client);
         g_clear_object (&priv->geoclue_manager);
-        g_clear_pointer (&priv->tzdb, tz_db_free);
-        g_clear_pointer (&priv->weather_tzdb, weather_tz_db_free);
+        g_clear_pointer (&priv->tzdb, tz_db_unref);
+        g_clear_object (&priv->pending_place);
 
         G_OBJECT_CLASS (cc_timezone_monitor_parent_class)->finalize (obj);
 }
@@ -449,6 +458,75 @@ cc_timezone_monitor_class_init (CcTimezoneMonitorClass *klass)
 	g_type_class_add_private (object_class, sizeof(CcTimezoneMonitorPrivate));
 }
 
+static void
+db_loaded (CcTimezoneMonitor *self)
+{
+        CcTimezoneMonitorPrivate *priv = GET_PRIVATE (self);
+        GeocodePlace *place;
+
+        priv->pending_dbs--;
+        if (priv->pending_dbs > 0 || priv->pending_place == NULL)
+                return;
+
+        place = priv->pending_place;
+        priv->pending_place = NULL;
+        process_location (self, place);
+        g_object_unref (place);
+}
+
+static void
+tzdb_ready_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+        CcTimezoneMonitorPrivate *priv;
+        TzDB *tzdb;
+        GError *error = NULL;
+
+        tzdb = tz_db_get_default_finish (result, &error);
+        if (tzdb == NULL) {
+                if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+                        g_error_free (error);
+                        return;
+                }
+                g_warning ("Could not load timezone database: %s", error->message);
+                g_error_free (error);
+        }
+
+        priv = GET_PRIVATE (user_data);
+        priv->tzdb = tzdb;
+
+        db_loaded (CC_TIMEZONE_MONITOR (user_data));
+}
+
+static void
+world_ready_cb (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+        CcTimezoneMonitorPrivate *priv;
+        GWeatherLocation *world;
+        GError *error = NULL;
+
+        world = weather_tz_get_world_finish (result, &error);
+        if (world == NULL) {
+                if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+                        g_error_free (error);
+                        return;
+                }
+                g_warning ("Could not load libgweather locations: %s", error->message);
+                g_error_free (error);
+        }
+
+        priv = GET_PRIVATE (user_data);
+        if (world != NULL) {
+                priv->weather_tzdb = weather_tz_get_default_db ();
+                gweather_location_unref (world);
+        }
+
+        db_loaded (CC_TIMEZONE_MONITOR (user_data));
+}
+
 static void
 cc_timezone_monitor_init (CcTimezoneMonitor *self)
 {
@@ -458,8 +536,11 @@ cc_timezone_monitor_init (CcTimezoneMonitor *self)
 
         priv->cancellable = g_cancellable_new ();
 
-        priv->tzdb = tz_load_db ();
-        priv->weather_tzdb = weather_tz_db_new ();
+        /* Both databases are only needed once geoclue reports a
+         * location; start loading the shared ones in the background. */
+        priv->pending_dbs = 2;
+        tz_db_get_default_async (priv->cancellable, tzdb_ready_cb, self);
+        weather_tz_get_world_async (priv->cancellable, world_ready_cb, self);
 
         priv->on_location_updated_id = 0;
 
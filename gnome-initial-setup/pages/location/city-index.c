@@ -0,0 +1,437 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* A word prefix index over the cities in the libgweather database,
+ * so that completing a search is a binary search instead of a walk
+ * over the whole world tree on every keystroke.
+ *
+ * Every city, region and country name is normalised (decomposed,
+ * without accents, case folded, with punctuation turned into spaces)
+ * and split into words.  The words are kept in one sorted array, each
+ * pointing back at the city it came from.
+ */
+
+#include "config.h"
+
+#include "city-index.h"
+
+#include <string.h>
+
+typedef struct
+{
+        GWeatherLocation *location;
+        gchar *display_name;
+        /* g_utf8_collate_key() of display_name, for sorting matches */
+        gchar *sort_key;
+        /* Normalised city name, and city, region and country names */
+        gchar *city_key;
+        gchar *all_key;
+} CityEntry;
+
+typedef struct
+{
+        const gchar *word;
+        guint entry;
+} CityWord;
+
+struct _CityIndex
+{
+        GWeatherLocation *world;
+
+        GArray *entries;        /* of CityEntry */
+        GArray *words;          /* of CityWord, sorted by word */
+        GStringChunk *strings;
+        GHashTable *by_location;
+
+        /* Avoids clearing a "seen" array for every lookup */
+        guint *seen;
+        guint generation;
+};
+
+static gchar *
+normalize_name (const gchar *name)
+{
+        gchar *decomposed, *folded;
+        GString *str;
+        const gchar *p;
+        gboolean space = TRUE;
+
+        decomposed = g_utf8_normalize (name, -1, G_NORMALIZE_NFKD);
+        if (decomposed == NULL)
+                return g_strdup ("");
+
+        folded = g_utf8_casefold (decomposed, -1);
+        str = g_string_sized_new (strlen (folded));
+
+        for (p = folded; *p; p = g_utf8_next_char (p)) {
+                gunichar c = g_utf8_get_char (p);
+
+                if (g_unichar_ismark (c))
+                        continue;
+
+                if (g_unichar_isalnum (c)) {
+                        g_string_append_unichar (str, c);
+                        space = FALSE;
+                } else if (!space) {
+                        g_string_append_c (str, ' ');
+                        space = TRUE;
+                }
+        }
+
+        if (str->len > 0 && str->str[str->len - 1] == ' ')
+                g_string_truncate (str, str->len - 1);
+
+        g_free (folded);
+        g_free (decomposed);
+
+        return g_string_free (str, FALSE);
+}
+
+static gint
+compare_words (gconstpointer a,
+               gconstpointer b)
+{
+        const CityWord *wa = a;
+        const CityWord *wb = b;
+        gint ret;
+
+        ret = strcmp (wa->word, wb->word);
+        if (ret != 0)
+                return ret;
+
+        return (gint) wa->entry - (gint) wb->entry;
+}
+
+static void
+add_words (CityIndex   *index,
+           const gchar *key,
+           guint        entry)
+{
+        gchar **words;
+        gint i;
+
+        words = g_strsplit (key, " ", -1);
+        for (i = 0; words[i]; i++) {
+                CityWord word;
+
+                if (*words[i] == '\0')
+                        continue;
+
+                word.word = g_string_chunk_insert_const (index->strings, words[i]);
+                word.entry = entry;
+                g_array_append_val (index->words, word);
+        }
+        g_strfreev (words);
+}
+
+static void
+add_city (CityIndex        *index,
+          GWeatherLocation *city)
+{
+        GWeatherLocation *parent;
+        const gchar *region = NULL;
+        const gchar *country = NULL;
+        GString *all;
+        CityEntry entry;
+
+        for (parent = gweather_location_get_parent (city);
+             parent != NULL;
+             parent = gweather_location_get_parent (parent)) {
+                switch (gweather_location_get_level (parent)) {
+                case GWEATHER_LOCATION_ADM1:
+                        region = gweather_location_get_name (parent);
+                        break;
+                case GWEATHER_LOCATION_COUNTRY:
+                        country = gweather_location_get_name (parent);
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        entry.location = city;
+        entry.city_key = normalize_name (gweather_location_get_name (city));
+
+        all = g_string_new (entry.city_key);
+        if (region) {
+                gchar *key = normalize_name (region);
+                g_string_append_printf (all, " %s", key);
+                g_free (key);
+        }
+        if (country) {
+                gchar *key = normalize_name (country);
+                g_string_append_printf (all, " %s", key);
+                g_free (key);
+        }
+        entry.all_key = g_string_free (all, FALSE);
+
+        if (region && country)
+                entry.display_name = g_strdup_printf ("%s, %s, %s",
+                                                      gweather_location_get_name (city),
+                                                      region, country);
+        else if (country)
+                entry.display_name = g_strdup_printf ("%s, %s",
+                                                      gweather_location_get_name (city),
+                                                      country);
+        else
+                entry.display_name = g_strdup (gweather_location_get_name (city));
+        entry.sort_key = g_utf8_collate_key (entry.display_name, -1);
+
+        add_words (index, entry.all_key, index->entries->len);
+        g_array_append_val (index->entries, entry);
+}
+
+static void
+add_cities (CityIndex        *index,
+            GWeatherLocation *location)
+{
+        GWeatherLocation **children;
+        gint i;
+
+        children = gweather_location_get_children (location);
+        for (i = 0; children[i]; i++) {
+                if (gweather_location_get_level (children[i]) == GWEATHER_LOCATION_CITY)
+                        add_city (index, children[i]);
+                else
+                        add_cities (index, children[i]);
+        }
+}
+
+CityIndex *
+city_index_new (GWeatherLocation *world)
+{
+        CityIndex *index;
+        guint i;
+
+        index = g_new0 (CityIndex, 1);
+        index->world = gweather_location_ref (world);
+        index->entries = g_array_new (FALSE, FALSE, sizeof (CityEntry));
+        index->words = g_array_new (FALSE, FALSE, sizeof (CityWord));
+        index->strings = g_string_chunk_new (64 * 1024);
+        index->by_location = g_hash_table_new (NULL, NULL);
+
+        add_cities (index, world);
+        g_array_sort (index->words, compare_words);
+
+        for (i = 0; i < index->entries->len; i++) {
+                CityEntry *entry = &g_array_index (index->entries, CityEntry, i);
+                g_hash_table_insert (index->by_location, entry->location, entry);
+        }
+
+        index->seen = g_new0 (guint, index->entries->len);
+
+        return index;
+}
+
+/* Returns the first word which starts with @prefix */
+static guint
+find_first_word (CityIndex   *index,
+                 const gchar *prefix,
+                 gsize        prefix_len)
+{
+        guint low = 0, high = index->words->len;
+
+        while (low < high) {
+                guint mid = low + (high - low) / 2;
+                const CityWord *word = &g_array_index (index->words, CityWord, mid);
+
+                if (strncmp (word->word, prefix, prefix_len) < 0)
+                        low = mid + 1;
+                else
+                        high = mid;
+        }
+
+        return low;
+}
+
+static gboolean
+has_word_prefix (const gchar *key,
+                 const gchar *prefix)
+{
+        gsize len = strlen (prefix);
+        const gchar *p = key;
+
+        while (p != NULL) {
+                if (strncmp (p, prefix, len) == 0)
+                        return TRUE;
+
+                p = strchr (p, ' ');
+                if (p != NULL)
+                        p++;
+        }
+
+        return FALSE;
+}
+
+typedef struct
+{
+        const CityEntry *entry;
+        gint rank;
+} CityMatch;
+
+static gint
+compare_matches (gconstpointer a,
+                 gconstpointer b)
+{
+        const CityMatch *ma = a;
+        const CityMatch *mb = b;
+
+        if (ma->rank != mb->rank)
+                return ma->rank - mb->rank;
+
+        return strcmp (ma->entry->sort_key, mb->entry->sort_key);
+}
+
+/* Lower is better: the whole query starts the city name, the first
+ * word of the query starts a word of the city name, or it only
+ * matched the region or country. */
+static gint
+rank_match (const CityEntry *entry,
+            const gchar     *query,
+            const gchar     *first_word)
+{
+        if (g_str_has_prefix (entry->city_key, query))
+                return 0;
+
+        if (has_word_prefix (entry->city_key, first_word))
+                return 1;
+
+        return 2;
+}
+
+/**
+ * city_index_lookup:
+ * @index: a #CityIndex
+ * @query: text typed by the user
+ * @max_results: the number of cities to return at most
+ *
+ * Finds the cities where each word of @query starts a word in the
+ * name of the city, its region or its country.
+ *
+ * Returns: (transfer container): the matching #GWeatherLocations,
+ * best first
+ */
+GPtrArray *
+city_index_lookup (CityIndex   *index,
+                   const gchar *query,
+                   guint        max_results)
+{
+        GPtrArray *results;
+        GArray *matches;
+        gchar *normalized;
+        gchar **words;
+        gsize first_len;
+        guint i, n_words;
+
+        results = g_ptr_array_new ();
+
+        normalized = normalize_name (query);
+        words = g_strsplit (normalized, " ", -1);
+        n_words = g_strv_length (words);
+        if (n_words == 0 || *words[0] == '\0')
+                goto out;
+
+        /* A new generation marks all entries unseen */
+        if (++index->generation == 0) {
+                memset (index->seen, 0, sizeof (guint) * index->entries->len);
+                index->generation = 1;
+        }
+
+        matches = g_array_new (FALSE, FALSE, sizeof (CityMatch));
+        first_len = strlen (words[0]);
+
+        for (i = find_first_word (index, words[0], first_len);
+             i < index->words->len;
+             i++) {
+                const CityWord *word = &g_array_index (index->words, CityWord, i);
+                const CityEntry *entry;
+                CityMatch match;
+                guint j;
+
+                if (strncmp (word->word, words[0], first_len) != 0)
+                        break;
+
+                if (index->seen[word->entry] == index->generation)
+                        continue;
+                index->seen[word->entry] = index->generation;
+
+                entry = &g_array_index (index->entries, CityEntry, word->entry);
+
+                for (j = 1; j < n_words; j++)
+                        if (!has_word_prefix (entry->all_key, words[j]))
+                                break;
+                if (j < n_words)
+                        continue;
+
+                match.entry = entry;
+                match.rank = rank_match (entry, normalized, words[0]);
+                g_array_append_val (matches, match);
+        }
+
+        g_array_sort (matches, compare_matches);
+
+        for (i = 0; i < matches->len && i < max_results; i++)
+                g_ptr_array_add (results,
+                                 g_array_index (matches, CityMatch, i).entry->location);
+
+        g_array_free (matches, TRUE);
+
+ out:
+        g_strfreev (words);
+        g_free (normalized);
+
+        return results;
+}
+
+const gchar *
+city_index_get_display_name (CityIndex        *index,
+                             GWeatherLocation *location)
+{
+        const CityEntry *entry;
+
+        entry = g_hash_table_lookup (index->by_location, location);
+        if (entry == NULL)
+                return NULL;
+
+        return entry->display_name;
+}
+
+void
+city_index_free (CityIndex *index)
+{
+        guint i;
+
+        for (i = 0; i < index->entries->len; i++) {
+                CityEntry *entry = &g_array_index (index->entries, CityEntry, i);
+
+                g_free (entry->display_name);
+                g_free (entry->sort_key);
+                g_free (entry->city_key);
+                g_free (entry->all_key);
+        }
+
+        g_array_free (index->entries, TRUE);
+        g_array_free (index->words, TRUE);
+        g_string_chunk_free (index->strings);
+        g_hash_table_destroy (index->by_location);
+        g_free (index->seen);
+        gweather_location_unref (index->world);
+
+        g_free (index);
+}
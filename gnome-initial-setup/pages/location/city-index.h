@@ -0,0 +1,38 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CITY_INDEX_H
+#define __CITY_INDEX_H
+
+#include <glib.h>
+
+#define GWEATHER_I_KNOW_THIS_IS_UNSTABLE
+#include <libgweather/gweather.h>
+
+typedef struct _CityIndex CityIndex;
+
+CityIndex        *city_index_new                  (GWeatherLocation *world);
+GPtrArray        *city_index_lookup               (CityIndex        *index,
+                                                   const gchar      *query,
+                                                   guint             max_results);
+const gchar      *city_index_get_display_name     (CityIndex        *index,
+                                                   GWeatherLocation *location);
+void              city_index_free                 (CityIndex        *index);
+
+#endif /* __CITY_INDEX_H */
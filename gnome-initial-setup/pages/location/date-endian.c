@@ -52,15 +52,18 @@ has_item (Item *items,
 	return FALSE;
 }
 
-DateEndianess
-date_endian_get_default (gboolean verbose)
+/* Results of parse_format() by LC_TIME locale name */
+static GHashTable *endian_cache = NULL;
+G_LOCK_DEFINE_STATIC (endian_cache);
+
+static DateEndianess
+parse_format (const char *fmt,
+	      gboolean    verbose)
 {
-	const char *fmt;
 	const char *p;
 	Item items[3];
 	guint i;
 
-	fmt = nl_langinfo (D_FMT);
 	g_return_val_if_fail (fmt != NULL, DEFAULT_ENDIANESS);
 
 	if (verbose)
@@ -142,16 +145,59 @@ date_endian_get_default (gboolean verbose)
 	return DEFAULT_ENDIANESS;
 }
 
+static DateEndianess
+compute_for_lang (const char *lang,
+		  gboolean    verbose)
+{
+	locale_t locale;
+	DateEndianess endian;
+
+	locale = newlocale (LC_TIME_MASK, lang, (locale_t) 0);
+	if (locale == (locale_t) 0) {
+		g_debug ("Locale '%s' is not available", lang);
+		return DEFAULT_ENDIANESS;
+	}
+
+	endian = parse_format (nl_langinfo_l (D_FMT, locale), verbose);
+	freelocale (locale);
+
+	return endian;
+}
+
+/* Neither of these change the process-wide locale, so they may be
+ * called from any thread. */
+DateEndianess
+date_endian_get_default (gboolean verbose)
+{
+	return parse_format (nl_langinfo (D_FMT), verbose);
+}
+
 DateEndianess
 date_endian_get_for_lang (const char *lang,
 			  gboolean    verbose)
 {
-	const char *old_lang;
+	gpointer value;
 	DateEndianess endian;
 
-	old_lang = setlocale (LC_TIME, lang);
-	endian = date_endian_get_default (verbose);
-	setlocale (LC_TIME, old_lang);
+	/* Always parse when asked to print the format */
+	if (verbose)
+		return compute_for_lang (lang, verbose);
+
+	G_LOCK (endian_cache);
+
+	if (endian_cache == NULL)
+		endian_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free, NULL);
+
+	if (g_hash_table_lookup_extended (endian_cache, lang, NULL, &value)) {
+		endian = GPOINTER_TO_INT (value);
+	} else {
+		endian = compute_for_lang (lang, FALSE);
+		g_hash_table_insert (endian_cache, g_strdup (lang),
+				     GINT_TO_POINTER (endian));
+	}
+
+	G_UNLOCK (endian_cache);
 
 	return endian;
 }
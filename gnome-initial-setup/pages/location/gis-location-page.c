@@ -43,25 +43,69 @@
 
 #include "cc-timezone-map.h"
 #include "cc-timezone-monitor.h"
+#include "city-index.h"
 #include "timedated.h"
+#include "weather-tz.h"
 
 #define GNOME_DESKTOP_USE_UNSTABLE_API
 #include <libgnome-desktop/gnome-wall-clock.h>
 
 #define DEFAULT_TZ "Europe/London"
 
+/* How long a timezone or time has to stay put before it is written */
+#define WRITE_DELAY_MS 300
+
+/* A value written to timedated where only the latest one matters.
+ * Writes are delayed until the value settles, and a write in flight
+ * is cancelled when a newer one is sent. */
+typedef struct
+{
+  guint timeout_id;
+  GCancellable *cancellable;
+} TimedatedWrite;
+
+/* Number of cities offered while typing in the location entry */
+#define MAX_COMPLETIONS 12
+
+enum
+{
+  COMPLETION_COLUMN_NAME,
+  COMPLETION_COLUMN_LOCATION,
+  COMPLETION_N_COLUMNS
+};
+
+/* Pieces of the page which arrive asynchronously after construction */
+typedef enum
+{
+  INIT_TIMEDATED = 1 << 0,
+  INIT_TZDB      = 1 << 1,
+  INIT_MAP       = 1 << 2,
+  INIT_ENTRY     = 1 << 3,
+  INIT_TIMEZONE  = 1 << 4,
+} InitState;
+
 struct _GisLocationPagePrivate
 {
   CcTimezoneMap *map;
   TzLocation *current_location;
 
+  InitState init_state;
+  guint init_idle_id;
+
   GDateTime *date;
   GnomeWallClock *clock_tracker;
 
   Timedate1 *dtm;
   GCancellable *cancellable;
 
+  TimedatedWrite timezone_write;
+  TimedatedWrite time_write;
+  gint64 pending_time;
+
   CcTimezoneMonitor *timezone_monitor;
+
+  CityIndex *city_index;        /* shared, see weather_tz_get_city_index() */
+  GtkListStore *completion_store;
 };
 typedef struct _GisLocationPagePrivate GisLocationPagePrivate;
 
@@ -77,6 +121,50 @@ day_changed (GtkWidget *widget, GisLocationPage *page);
 static void
 month_year_changed (GtkWidget *widget, GisLocationPage *page);
 
+static void
+timedated_write_queue (TimedatedWrite *write,
+                       GSourceFunc     func,
+                       gpointer        user_data)
+{
+  if (write->timeout_id)
+    g_source_remove (write->timeout_id);
+
+  write->timeout_id = g_timeout_add (WRITE_DELAY_MS, func, user_data);
+}
+
+/* Returns the cancellable to use for the call about to be made */
+static GCancellable *
+timedated_write_begin (TimedatedWrite *write)
+{
+  if (write->timeout_id) {
+    g_source_remove (write->timeout_id);
+    write->timeout_id = 0;
+  }
+
+  if (write->cancellable) {
+    g_cancellable_cancel (write->cancellable);
+    g_object_unref (write->cancellable);
+  }
+
+  write->cancellable = g_cancellable_new ();
+
+  return write->cancellable;
+}
+
+static void
+timedated_write_clear (TimedatedWrite *write)
+{
+  if (write->timeout_id) {
+    g_source_remove (write->timeout_id);
+    write->timeout_id = 0;
+  }
+
+  if (write->cancellable) {
+    g_cancellable_cancel (write->cancellable);
+    g_clear_object (&write->cancellable);
+  }
+}
+
 static void
 set_timezone_cb (GObject      *source,
                  GAsyncResult *res,
@@ -89,26 +177,39 @@ set_timezone_cb (GObject      *source,
                                            res,
                                            &error)) {
     /* TODO: display any error in a user friendly way */
-    g_warning ("Could not set system timezone: %s", error->message);
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning ("Could not set system timezone: %s", error->message);
     g_error_free (error);
   }
 }
 
+static gboolean
+set_timezone_timeout (gpointer user_data)
+{
+  GisLocationPage *page = user_data;
+  GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
+  GCancellable *cancellable;
+
+  priv->timezone_write.timeout_id = 0;
+  cancellable = timedated_write_begin (&priv->timezone_write);
+
+  timedate1_call_set_timezone (priv->dtm,
+                               priv->current_location->zone,
+                               TRUE,
+                               cancellable,
+                               set_timezone_cb,
+                               page);
+
+  return G_SOURCE_REMOVE;
+}
 
 static void
 queue_set_timezone (GisLocationPage *page)
 {
   GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
 
-  /* for now just do it */
-  if (priv->current_location) {
-    timedate1_call_set_timezone (priv->dtm,
-                                 priv->current_location->zone,
-                                 TRUE,
-                                 NULL,
-                                 set_timezone_cb,
-                                 page);
-  }
+  if (priv->dtm && priv->current_location)
+    timedated_write_queue (&priv->timezone_write, set_timezone_timeout, page);
 }
 
 static void
@@ -174,7 +275,8 @@ timezone_changed_cb (CcTimezoneMonitor *timezone_monitor,
 
   priv->current_location = location;
 
-  cc_timezone_map_set_timezone (priv->map, location->zone);
+  if (priv->map)
+    cc_timezone_map_set_timezone (priv->map, location->zone);
 
   update_timezone (page);
 
@@ -203,7 +305,8 @@ set_location_from_gweather_location (GisLocationPage  *page,
       name = id;
     }
     gtk_label_set_label (label, name);
-    cc_timezone_map_set_timezone (priv->map, id);
+    if (priv->map)
+      cc_timezone_map_set_timezone (priv->map, id);
   }
 
   if (city != NULL) {
@@ -216,21 +319,6 @@ set_location_from_gweather_location (GisLocationPage  *page,
   g_free (city);
 }
 
-static void
-location_changed (GObject *object, GParamSpec *param, GisLocationPage *page)
-{
-  GWeatherLocationEntry *entry = GWEATHER_LOCATION_ENTRY (object);
-  GWeatherLocation *gloc;
-
-  gloc = gweather_location_entry_get_location (entry);
-  if (gloc == NULL)
-    return;
-
-  set_location_from_gweather_location (page, gloc);
-
-  gweather_location_unref (gloc);
-}
-
 static void
 set_using_ntp_cb (GObject *object, GAsyncResult *res, gpointer user_data)
 {
@@ -379,7 +467,8 @@ set_time_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 
   if(!timedate1_call_set_time_finish (TIMEDATE1 (source), res, &error))
     {
-      g_warning ("Could not set system time: %s", error->message);
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Could not set system time: %s", error->message);
       g_error_free (error);
     }
   else
@@ -389,22 +478,41 @@ set_time_cb (GObject *source, GAsyncResult *res, gpointer user_data)
     }
 }
 
-static void
-queue_set_datetime (GisLocationPage *page)
+static gboolean
+set_time_timeout (gpointer user_data)
 {
+  GisLocationPage *page = user_data;
   GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
-  gint64 unixtime;
+  GCancellable *cancellable;
 
-  /* timedated expects number of microseconds since 1 Jan 1970 UTC */
-  unixtime = g_date_time_to_unix (priv->date);
+  priv->time_write.timeout_id = 0;
+  cancellable = timedated_write_begin (&priv->time_write);
 
   timedate1_call_set_time (priv->dtm,
-                           unixtime * G_TIME_SPAN_SECOND,
+                           priv->pending_time,
                            FALSE,
                            TRUE,
-                           priv->cancellable,
+                           cancellable,
                            set_time_cb,
                            page);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+queue_set_datetime (GisLocationPage *page)
+{
+  GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
+
+  if (!priv->dtm)
+    return;
+
+  /* timedated expects number of microseconds since 1 Jan 1970 UTC.
+   * Take the value now, the wall clock replaces priv->date every
+   * minute. */
+  priv->pending_time = g_date_time_to_unix (priv->date) * G_TIME_SPAN_SECOND;
+
+  timedated_write_queue (&priv->time_write, set_time_timeout, page);
 }
 
 static void
@@ -611,64 +719,14 @@ determine_location (GtkWidget       *widget,
 #endif
 
 static void
-gis_location_page_constructed (GObject *object)
+apply_system_timezone (GisLocationPage *page)
 {
-  GisLocationPage *page = GIS_LOCATION_PAGE (object);
   GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
-  GtkWidget *frame, *map, *entry;
-  GWeatherLocation *world;
-  GSettings *clock_settings;
-  GError *error;
-  const gchar *clock_format;
   const gchar *timezone;
-  DateEndianess endianess;
-  GtkWidget *widget;
-  gint i;
-  GtkAdjustment *adjustment;
-  gchar *time_buttons[] = { "hour_up_button", "hour_down_button",
-                            "min_up_button", "min_down_button" };
-
-  G_OBJECT_CLASS (gis_location_page_parent_class)->constructed (object);
-
-  gtk_container_add (GTK_CONTAINER (page), WID ("location-page"));
-
-  frame = WID("location-map-frame");
-
-  priv->cancellable = g_cancellable_new ();
-  error = NULL;
-  priv->dtm = timedate1_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-                                                G_DBUS_PROXY_FLAGS_NONE,
-                                                "org.freedesktop.timedate1",
-                                                "/org/freedesktop/timedate1",
-                                                NULL,
-                                                &error);
-  if (priv->dtm == NULL) {
-    g_error ("Failed to create proxy for timedated: %s", error->message);
-    exit (1);
-  }
-
-  priv->map = cc_timezone_map_new ();
-  map = GTK_WIDGET (priv->map);
-  gtk_widget_set_hexpand (map, TRUE);
-  gtk_widget_set_vexpand (map, TRUE);
-  gtk_widget_set_halign (map, GTK_ALIGN_FILL);
-  gtk_widget_set_valign (map, GTK_ALIGN_FILL);
-  gtk_widget_show (map);
-
-  gtk_container_add (GTK_CONTAINER (frame), map);
 
-  world = gweather_location_new_world (TRUE);
-  entry = gweather_location_entry_new (world);
-  gtk_entry_set_placeholder_text (GTK_ENTRY (entry), _("Search for a location"));
-  gtk_widget_set_halign (entry, GTK_ALIGN_FILL);
-  gtk_widget_show (entry);
-
-  frame = WID("location-page");
-#if WANT_GEOCLUE
-  gtk_grid_attach (GTK_GRID (frame), entry, 1, 1, 1, 1);
-#else
-  gtk_grid_attach (GTK_GRID (frame), entry, 0, 1, 2, 1);
-#endif
+  /* A location may have been picked while the page was loading */
+  if (priv->current_location != NULL)
+    return;
 
   timezone = timedate1_get_timezone (priv->dtm);
 
@@ -686,33 +744,308 @@ gis_location_page_constructed (GObject *object)
   }
 
   update_timezone (page);
+}
 
-  /*
-   * When running on a Live session, it's important to try to not touch
-   * the system clock and use the RTC as local rather than UTC. Timedate1
-   * has a method that tries to do that (although there are no guarantees
-   * that it works all the time.)
-   */
-  if (gis_driver_is_live_session (GIS_PAGE (object)->driver)) {
-    timedate1_call_set_local_rtc_sync (priv->dtm,
-                                       TRUE,
-                                       TRUE,
-                                       FALSE,
-                                       NULL,
-                                       &error);
-
-    if (error) {
+static void
+set_local_rtc_cb (GObject      *source,
+                  GAsyncResult *res,
+                  gpointer      user_data)
+{
+  GError *error = NULL;
+
+  if (!timedate1_call_set_local_rtc_finish (TIMEDATE1 (source), res, &error)) {
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
       g_warning ("Error calling SetLocalRTC(): %s", error->message);
-      g_clear_error (&error);
-    }
+    g_error_free (error);
   }
+}
 
-  g_signal_connect (G_OBJECT (entry), "notify::location",
-                    G_CALLBACK (location_changed), page);
+/* Called whenever one of the InitState pieces arrives; sets up
+ * whatever has become possible with what is there now. */
+static void
+update_init_state (GisLocationPage *page,
+                   InitState        arrived)
+{
+  GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
+  InitState needed;
+
+  priv->init_state |= arrived;
+
+  if (arrived == INIT_TIMEDATED) {
+    update_ntp_switch_from_system (page);
+    gtk_widget_set_sensitive (WID ("network_time_switch"), TRUE);
+
+    /*
+     * When running on a Live session, it's important to try to not touch
+     * the system clock and use the RTC as local rather than UTC. Timedate1
+     * has a method that tries to do that (although there are no guarantees
+     * that it works all the time.)
+     */
+    if (gis_driver_is_live_session (GIS_PAGE (page)->driver))
+      timedate1_call_set_local_rtc (priv->dtm,
+                                    TRUE,
+                                    TRUE,
+                                    FALSE,
+                                    priv->cancellable,
+                                    set_local_rtc_cb,
+                                    page);
+  }
+
+  needed = INIT_TIMEDATED | INIT_TZDB | INIT_MAP;
+  if ((priv->init_state & needed) == needed &&
+      !(priv->init_state & INIT_TIMEZONE)) {
+    priv->init_state |= INIT_TIMEZONE;
+    apply_system_timezone (page);
+  }
+}
+
+static void
+timedated_ready_cb (GObject      *source_object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  GisLocationPage *page = user_data;
+  GisLocationPagePrivate *priv;
+  Timedate1 *dtm;
+  GError *error = NULL;
+
+  dtm = timedate1_proxy_new_for_bus_finish (result, &error);
+  if (dtm == NULL) {
+    /* Keep the time and date controls insensitive; there is nothing
+     * which could apply them. */
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning ("Failed to create proxy for timedated: %s", error->message);
+    g_error_free (error);
+    return;
+  }
+
+  priv = gis_location_page_get_instance_private (page);
+  priv->dtm = dtm;
+
+  update_init_state (page, INIT_TIMEDATED);
+}
+
+static void
+tzdb_ready_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  TzDB *tzdb;
+  GError *error = NULL;
+
+  tzdb = tz_db_get_default_finish (result, &error);
+  if (tzdb == NULL) {
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning ("Could not load timezone database: %s", error->message);
+    g_error_free (error);
+    return;
+  }
+
+  /* The map picks up the shared database itself */
+  tz_db_unref (tzdb);
+
+  update_init_state (GIS_LOCATION_PAGE (user_data), INIT_TZDB);
+}
+
+static void
+entry_text_changed (GtkEditable     *editable,
+                    GisLocationPage *page)
+{
+  GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
+  GPtrArray *cities;
+  guint i;
+
+  gtk_list_store_clear (priv->completion_store);
+
+  cities = city_index_lookup (priv->city_index,
+                              gtk_entry_get_text (GTK_ENTRY (editable)),
+                              MAX_COMPLETIONS);
+  for (i = 0; i < cities->len; i++) {
+    GWeatherLocation *city = cities->pdata[i];
+
+    gtk_list_store_insert_with_values (priv->completion_store, NULL, -1,
+                                       COMPLETION_COLUMN_NAME,
+                                       city_index_get_display_name (priv->city_index, city),
+                                       COMPLETION_COLUMN_LOCATION, city,
+                                       -1);
+  }
+  g_ptr_array_unref (cities);
+}
+
+static gboolean
+completion_match_func (GtkEntryCompletion *completion,
+                       const gchar        *key,
+                       GtkTreeIter        *iter,
+                       gpointer            user_data)
+{
+  /* The store only ever holds the matches for the current text */
+  return TRUE;
+}
+
+static gboolean
+completion_match_selected (GtkEntryCompletion *completion,
+                           GtkTreeModel       *model,
+                           GtkTreeIter        *iter,
+                           GisLocationPage    *page)
+{
+  GtkWidget *entry = gtk_entry_completion_get_entry (completion);
+  GWeatherLocation *city;
+  gchar *name;
+
+  gtk_tree_model_get (model, iter,
+                      COMPLETION_COLUMN_NAME, &name,
+                      COMPLETION_COLUMN_LOCATION, &city,
+                      -1);
+
+  g_signal_handlers_block_by_func (entry, entry_text_changed, page);
+  gtk_entry_set_text (GTK_ENTRY (entry), name);
+  gtk_editable_set_position (GTK_EDITABLE (entry), -1);
+  g_signal_handlers_unblock_by_func (entry, entry_text_changed, page);
+
+  set_location_from_gweather_location (page, city);
+
+  gweather_location_unref (city);
+  g_free (name);
+
+  return TRUE;
+}
+
+/* GWeatherLocationEntry builds a completion model over the whole
+ * world tree and walks it for every key press, which is slow on low
+ * end hardware; a plain entry completes from a CityIndex instead. */
+static void
+setup_city_completion (GisLocationPage *page,
+                       GtkWidget       *entry,
+                       CityIndex       *index)
+{
+  GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
+  GtkEntryCompletion *completion;
+
+  priv->city_index = index;
+  priv->completion_store = gtk_list_store_new (COMPLETION_N_COLUMNS,
+                                               G_TYPE_STRING,
+                                               GWEATHER_TYPE_LOCATION);
+
+  /* Must run before the completion's own handler, so that the store
+   * is up to date when it decides whether to pop up */
+  g_signal_connect (entry, "changed",
+                    G_CALLBACK (entry_text_changed), page);
+
+  completion = gtk_entry_completion_new ();
+  gtk_entry_completion_set_model (completion, GTK_TREE_MODEL (priv->completion_store));
+  gtk_entry_completion_set_text_column (completion, COMPLETION_COLUMN_NAME);
+  gtk_entry_completion_set_match_func (completion, completion_match_func, NULL, NULL);
+  g_signal_connect (completion, "match-selected",
+                    G_CALLBACK (completion_match_selected), page);
+
+  gtk_entry_set_completion (GTK_ENTRY (entry), completion);
+  g_object_unref (completion);
+}
+
+static void
+create_entry (GisLocationPage *page,
+              CityIndex       *index)
+{
+  GtkWidget *entry, *grid;
+
+  entry = gtk_entry_new ();
+  gtk_entry_set_placeholder_text (GTK_ENTRY (entry), _("Search for a location"));
+  gtk_widget_set_halign (entry, GTK_ALIGN_FILL);
+  setup_city_completion (page, entry, index);
+  gtk_widget_show (entry);
+
+  grid = WID("location-page");
+#if WANT_GEOCLUE
+  gtk_grid_attach (GTK_GRID (grid), entry, 1, 1, 1, 1);
+#else
+  gtk_grid_attach (GTK_GRID (grid), entry, 0, 1, 2, 1);
+#endif
+
+  update_init_state (page, INIT_ENTRY);
+}
+
+static void
+world_ready_cb (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  GisLocationPage *page = user_data;
+  GWeatherLocation *world;
+  GError *error = NULL;
+
+  world = weather_tz_get_world_finish (result, &error);
+  if (world == NULL) {
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning ("Could not load libgweather locations: %s", error->message);
+    g_error_free (error);
+    return;
+  }
+
+  /* The city index is built in the same thread as the world */
+  create_entry (page, weather_tz_get_city_index ());
+  gweather_location_unref (world);
+}
+
+static gboolean
+create_map_idle (gpointer user_data)
+{
+  GisLocationPage *page = user_data;
+  GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
+  GtkWidget *map;
+
+  priv->init_idle_id = 0;
+
+  priv->map = cc_timezone_map_new ();
+  map = GTK_WIDGET (priv->map);
+  gtk_widget_set_hexpand (map, TRUE);
+  gtk_widget_set_vexpand (map, TRUE);
+  gtk_widget_set_halign (map, GTK_ALIGN_FILL);
+  gtk_widget_set_valign (map, GTK_ALIGN_FILL);
+  gtk_widget_show (map);
+
+  gtk_container_add (GTK_CONTAINER (WID("location-map-frame")), map);
 
   g_signal_connect (map, "location-changed",
                     G_CALLBACK (location_changed_cb), page);
 
+  update_init_state (page, INIT_MAP);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gis_location_page_constructed (GObject *object)
+{
+  GisLocationPage *page = GIS_LOCATION_PAGE (object);
+  GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
+  GSettings *clock_settings;
+  const gchar *clock_format;
+  DateEndianess endianess;
+  GtkWidget *widget;
+  gint i;
+  GtkAdjustment *adjustment;
+  gchar *time_buttons[] = { "hour_up_button", "hour_down_button",
+                            "min_up_button", "min_down_button" };
+
+  G_OBJECT_CLASS (gis_location_page_parent_class)->constructed (object);
+
+  gtk_container_add (GTK_CONTAINER (page), WID ("location-page"));
+
+  /* Only the static parts of the page are set up here.  timedated, the
+   * timezone database, the map and the location entry are filled in as
+   * they become available; see update_init_state(). */
+  priv->cancellable = g_cancellable_new ();
+  timedate1_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+                               G_DBUS_PROXY_FLAGS_NONE,
+                               "org.freedesktop.timedate1",
+                               "/org/freedesktop/timedate1",
+                               priv->cancellable,
+                               timedated_ready_cb,
+                               page);
+  tz_db_get_default_async (priv->cancellable, tzdb_ready_cb, page);
+  weather_tz_get_world_async (priv->cancellable, world_ready_cb, page);
+  priv->init_idle_id = g_idle_add (create_map_idle, page);
+
 #if WANT_GEOCLUE
   g_signal_connect (WID ("location-auto-button"), "clicked",
                     G_CALLBACK (determine_location), page);
@@ -720,8 +1053,10 @@ gis_location_page_constructed (GObject *object)
   gtk_widget_hide (WID ("location-auto-button"));
 #endif
 
-  /* set up network time button */
-  update_ntp_switch_from_system (page);
+  /* set up network time button; it stays insensitive, along with the
+   * time and date, until timedated tells us whether NTP is in use */
+  update_widget_state_for_ntp (page, TRUE);
+  gtk_widget_set_sensitive (WID ("network_time_switch"), FALSE);
   g_signal_connect(WID ("network_time_switch"), "notify::active",
                    G_CALLBACK (change_ntp), page);
 
@@ -792,9 +1127,26 @@ gis_location_page_dispose (GObject *object)
   GisLocationPage *page = GIS_LOCATION_PAGE (object);
   GisLocationPagePrivate *priv = gis_location_page_get_instance_private (page);
 
+  if (priv->init_idle_id) {
+    g_source_remove (priv->init_idle_id);
+    priv->init_idle_id = 0;
+  }
+
+  /* Don't lose a value which is still waiting to settle */
+  if (priv->timezone_write.timeout_id)
+    timedate1_call_set_timezone (priv->dtm, priv->current_location->zone,
+                                 TRUE, NULL, NULL, NULL);
+  if (priv->time_write.timeout_id)
+    timedate1_call_set_time (priv->dtm, priv->pending_time,
+                             FALSE, TRUE, NULL, NULL, NULL);
+
+  timedated_write_clear (&priv->timezone_write);
+  timedated_write_clear (&priv->time_write);
+
   g_clear_object (&priv->dtm);
   g_clear_object (&priv->clock_tracker);
   g_clear_object (&priv->timezone_monitor);
+  g_clear_object (&priv->completion_store);
   g_clear_pointer (&priv->date, g_date_time_unref);
   if (priv->cancellable) {
     g_cancellable_cancel (priv->cancellable);
@@ -0,0 +1,74 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (C) 2016 Endless Mobile, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Build-time helper which writes a reduced copy of one of the timezone
+ * map layers.  Level N is the source image scaled down by 2^N, using
+ * the expensive filter so that the widget only has to do a cheap final
+ * scale from the nearest level at runtime.
+ *
+ *   map-levels INPUT OUTPUT LEVEL
+ */
+
+#include <stdlib.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+int
+main (int argc, char **argv)
+{
+  GdkPixbuf *orig, *scaled;
+  GError *error = NULL;
+  gint level, width, height;
+
+  if (argc != 4)
+    {
+      g_printerr ("Usage: %s INPUT OUTPUT LEVEL\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  level = atoi (argv[3]);
+  if (level < 1 || level > 8)
+    {
+      g_printerr ("Invalid level '%s'\n", argv[3]);
+      return EXIT_FAILURE;
+    }
+
+  orig = gdk_pixbuf_new_from_file (argv[1], &error);
+  if (!orig)
+    {
+      g_printerr ("Could not load %s: %s\n", argv[1], error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  width = MAX (1, gdk_pixbuf_get_width (orig) >> level);
+  height = MAX (1, gdk_pixbuf_get_height (orig) >> level);
+  scaled = gdk_pixbuf_scale_simple (orig, width, height, GDK_INTERP_HYPER);
+
+  if (!gdk_pixbuf_save (scaled, argv[2], "png", &error, NULL))
+    {
+      g_printerr ("Could not save %s: %s\n", argv[2], error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  g_object_unref (scaled);
+  g_object_unref (orig);
+
+  return EXIT_SUCCESS;
+}
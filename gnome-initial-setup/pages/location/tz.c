@@ -65,6 +65,7 @@ tz_load_db (void)
 	}
 
 	tz_db = g_new0 (TzDB, 1);
+	tz_db->ref_count = 1;
 	tz_db->locations = g_ptr_array_new ();
 
 	while (fgets (buf, sizeof(buf), tzfile))
@@ -141,15 +142,145 @@ tz_location_free (TzLocation *loc)
 	g_free (loc);
 }
 
+TzDB *
+tz_db_ref (TzDB *db)
+{
+	g_return_val_if_fail (db != NULL, NULL);
+
+	g_atomic_int_inc (&db->ref_count);
+
+	return db;
+}
+
 void
-tz_db_free (TzDB *db)
+tz_db_unref (TzDB *db)
 {
+	g_return_if_fail (db != NULL);
+
+	if (!g_atomic_int_dec_and_test (&db->ref_count))
+		return;
+
 	g_ptr_array_foreach (db->locations, (GFunc) tz_location_free, NULL);
 	g_ptr_array_free (db->locations, TRUE);
 	g_hash_table_destroy (db->backward);
 	g_free (db);
 }
 
+/* The process-wide database.  It is loaded at most once, in a thread,
+ * and only touched from the main context afterwards. */
+static TzDB *default_db = NULL;
+static GList *default_db_waiters = NULL;
+static gboolean default_db_loading = FALSE;
+
+/**
+ * tz_db_get_default:
+ *
+ * Returns: (transfer full): a reference to the shared database, or
+ * %NULL if it has not finished loading yet
+ */
+TzDB *
+tz_db_get_default (void)
+{
+	if (default_db == NULL)
+		return NULL;
+
+	return tz_db_ref (default_db);
+}
+
+static void
+load_default_db_thread (GTask        *task,
+			gpointer      source_object,
+			gpointer      task_data,
+			GCancellable *cancellable)
+{
+	TzDB *db;
+
+	db = tz_load_db ();
+	if (db == NULL)
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+					 "Could not load the timezone database");
+	else
+		g_task_return_pointer (task, db, (GDestroyNotify) tz_db_unref);
+}
+
+static void
+return_default_db (GTask  *task,
+		   GError *error)
+{
+	if (error != NULL)
+		g_task_return_error (task, g_error_copy (error));
+	else
+		g_task_return_pointer (task, tz_db_ref (default_db),
+				       (GDestroyNotify) tz_db_unref);
+}
+
+static void
+default_db_loaded (GObject      *source_object,
+		   GAsyncResult *result,
+		   gpointer      user_data)
+{
+	GError *error = NULL;
+	GList *waiters, *l;
+
+	default_db = g_task_propagate_pointer (G_TASK (result), &error);
+	default_db_loading = FALSE;
+
+	waiters = default_db_waiters;
+	default_db_waiters = NULL;
+
+	for (l = waiters; l != NULL; l = l->next) {
+		return_default_db (l->data, error);
+		g_object_unref (l->data);
+	}
+
+	g_list_free (waiters);
+	g_clear_error (&error);
+}
+
+/**
+ * tz_db_get_default_async:
+ *
+ * Gets the shared database, loading it in a worker thread the first
+ * time.  @callback is always invoked from the main context; use
+ * tz_db_get_default_finish() to get a reference to the database.
+ */
+void
+tz_db_get_default_async (GCancellable        *cancellable,
+			 GAsyncReadyCallback  callback,
+			 gpointer             user_data)
+{
+	GTask *task;
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, tz_db_get_default_async);
+
+	if (default_db != NULL) {
+		return_default_db (task, NULL);
+		g_object_unref (task);
+		return;
+	}
+
+	default_db_waiters = g_list_append (default_db_waiters, task);
+
+	if (!default_db_loading) {
+		GTask *load_task;
+
+		default_db_loading = TRUE;
+		load_task = g_task_new (NULL, NULL, default_db_loaded, NULL);
+		g_task_run_in_thread (load_task, load_default_db_thread);
+		g_object_unref (load_task);
+	}
+}
+
+TzDB *
+tz_db_get_default_finish (GAsyncResult  *result,
+			  GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 GPtrArray *
 tz_get_locations (TzDB *db)
 {
@@ -26,7 +26,7 @@
 #ifndef _E_TZ_H
 #define _E_TZ_H
 
-#include <glib.h>
+#include <gio/gio.h>
 
 #ifndef __sun
 #  define TZ_DATA_FILE "/usr/share/zoneinfo/zone.tab"
@@ -39,10 +39,13 @@ typedef struct _TzLocation TzLocation;
 typedef struct _TzInfo TzInfo;
 
 
+/* A loaded database is never modified, so it can be shared freely
+ * between widgets; see tz_db_get_default_async(). */
 struct _TzDB
 {
 	GPtrArray  *locations;
 	GHashTable *backward;
+	gint        ref_count;
 };
 
 struct _TzLocation
@@ -52,8 +55,6 @@ struct _TzLocation
 	gdouble longitude;
 	gchar *zone;
 	gchar *comment;
-
-	gdouble dist; /* distance to clicked point for comparison */
 };
 
 /* see the glibc info page information on time zone information */
@@ -72,7 +73,14 @@ struct _TzInfo
 
 
 TzDB      *tz_load_db                 (void);
-void       tz_db_free                 (TzDB *db);
+TzDB      *tz_db_ref                  (TzDB *db);
+void       tz_db_unref                (TzDB *db);
+TzDB      *tz_db_get_default          (void);
+void       tz_db_get_default_async    (GCancellable *cancellable,
+				       GAsyncReadyCallback callback,
+				       gpointer user_data);
+TzDB      *tz_db_get_default_finish   (GAsyncResult *result,
+				       GError **error);
 char *     tz_info_get_clean_name     (TzDB *tz_db,
 				       const char *tz);
 GPtrArray *tz_get_locations           (TzDB *db);
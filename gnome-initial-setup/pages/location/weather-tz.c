@@ -20,11 +20,14 @@
 #include "config.h"
 
 #include "weather-tz.h"
+#include "city-index.h"
 #include "tz.h"
 
 #define GWEATHER_I_KNOW_THIS_IS_UNSTABLE
 #include <libgweather/gweather.h>
 
+#include <gio/gio.h>
+
 struct _WeatherTzDB
 {
         GList *tz_locations;
@@ -114,14 +117,12 @@ weather_tz_db_get_locations (WeatherTzDB *tzdb)
         return g_list_copy (tzdb->tz_locations);
 }
 
-WeatherTzDB *
-weather_tz_db_new (void)
+static WeatherTzDB *
+weather_tz_db_new (GWeatherLocation *world)
 {
         GList *cities;
-        GWeatherLocation *world;
         WeatherTzDB *tzdb;
 
-        world = gweather_location_get_world ();
         cities = location_get_cities (world);
 
         tzdb = g_new0 (WeatherTzDB, 1);
@@ -132,10 +133,185 @@ weather_tz_db_new (void)
         return tzdb;
 }
 
-void
+static void
 weather_tz_db_free (WeatherTzDB *tzdb)
 {
         g_list_free_full (tzdb->tz_locations, (GDestroyNotify) tz_location_free);
 
         g_free (tzdb);
 }
+
+/* The process-wide libgweather world.  Parsing it takes a while, so it
+ * is loaded at most once, in a thread, and only touched from the main
+ * context afterwards.  libgweather is not thread safe, not even its
+ * reference counts, so everything else that has to walk the whole
+ * tree is built in that same thread before the world is handed over. */
+static GWeatherLocation *default_world = NULL;
+static WeatherTzDB *default_tzdb = NULL;
+static CityIndex *default_city_index = NULL;
+static GList *default_world_waiters = NULL;
+static gboolean default_world_loading = FALSE;
+
+typedef struct
+{
+        GWeatherLocation *world;
+        WeatherTzDB *tzdb;
+        CityIndex *city_index;
+} WorldData;
+
+static void
+world_data_free (WorldData *data)
+{
+        gweather_location_unref (data->world);
+        weather_tz_db_free (data->tzdb);
+        city_index_free (data->city_index);
+        g_free (data);
+}
+
+/**
+ * weather_tz_get_world:
+ *
+ * Returns: (transfer full): a reference to the shared world, or %NULL
+ * if it has not finished loading yet
+ */
+GWeatherLocation *
+weather_tz_get_world (void)
+{
+        if (default_world == NULL)
+                return NULL;
+
+        return gweather_location_ref (default_world);
+}
+
+static void
+load_world_thread (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+        GWeatherLocation *world;
+        WorldData *data;
+
+        world = gweather_location_get_world ();
+        if (world == NULL) {
+                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                         "Could not load the libgweather locations");
+                return;
+        }
+
+        data = g_new0 (WorldData, 1);
+        data->world = gweather_location_ref (world);
+        data->tzdb = weather_tz_db_new (world);
+        data->city_index = city_index_new (world);
+
+        g_task_return_pointer (task, data, (GDestroyNotify) world_data_free);
+}
+
+static void
+return_default_world (GTask  *task,
+                      GError *error)
+{
+        if (error != NULL)
+                g_task_return_error (task, g_error_copy (error));
+        else
+                g_task_return_pointer (task, gweather_location_ref (default_world),
+                                       (GDestroyNotify) gweather_location_unref);
+}
+
+static void
+default_world_loaded (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+        WorldData *data;
+        GError *error = NULL;
+        GList *waiters, *l;
+
+        data = g_task_propagate_pointer (G_TASK (result), &error);
+        if (data != NULL) {
+                default_world = data->world;
+                default_tzdb = data->tzdb;
+                default_city_index = data->city_index;
+                g_free (data);
+        }
+        default_world_loading = FALSE;
+
+        waiters = default_world_waiters;
+        default_world_waiters = NULL;
+
+        for (l = waiters; l != NULL; l = l->next) {
+                return_default_world (l->data, error);
+                g_object_unref (l->data);
+        }
+
+        g_list_free (waiters);
+        g_clear_error (&error);
+}
+
+/**
+ * weather_tz_get_world_async:
+ *
+ * Gets the shared libgweather world, loading it in a worker thread
+ * the first time.  @callback is always invoked from the main context;
+ * use weather_tz_get_world_finish() to get a reference to the world.
+ */
+void
+weather_tz_get_world_async (GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+        GTask *task;
+
+        task = g_task_new (NULL, cancellable, callback, user_data);
+        g_task_set_source_tag (task, weather_tz_get_world_async);
+
+        if (default_world != NULL) {
+                return_default_world (task, NULL);
+                g_object_unref (task);
+                return;
+        }
+
+        default_world_waiters = g_list_append (default_world_waiters, task);
+
+        if (!default_world_loading) {
+                GTask *load_task;
+
+                default_world_loading = TRUE;
+                load_task = g_task_new (NULL, NULL, default_world_loaded, NULL);
+                g_task_run_in_thread (load_task, load_world_thread);
+                g_object_unref (load_task);
+        }
+}
+
+GWeatherLocation *
+weather_tz_get_world_finish (GAsyncResult  *result,
+                             GError       **error)
+{
+        g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+        return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * weather_tz_get_default_db:
+ *
+ * Returns: (transfer none): the timezones of the cities in the shared
+ * world, or %NULL if it has not finished loading yet
+ */
+WeatherTzDB *
+weather_tz_get_default_db (void)
+{
+        return default_tzdb;
+}
+
+/**
+ * weather_tz_get_city_index:
+ *
+ * Returns: (transfer none): an index over the cities in the shared
+ * world, or %NULL if it has not finished loading yet
+ */
+CityIndex *
+weather_tz_get_city_index (void)
+{
+        return default_city_index;
+}
@@ -21,11 +21,24 @@
 #define __WEATHER_TZ_H
 
 #include <glib.h>
+#include <gio/gio.h>
+
+#define GWEATHER_I_KNOW_THIS_IS_UNSTABLE
+#include <libgweather/gweather.h>
+
+#include "city-index.h"
 
 typedef struct _WeatherTzDB WeatherTzDB;
 
-WeatherTzDB     *weather_tz_db_new              (void);
-GList           *weather_tz_db_get_locations    (WeatherTzDB *db);
-void             weather_tz_db_free             (WeatherTzDB *db);
+GList            *weather_tz_db_get_locations    (WeatherTzDB         *db);
+
+GWeatherLocation *weather_tz_get_world           (void);
+void              weather_tz_get_world_async     (GCancellable        *cancellable,
+                                                  GAsyncReadyCallback  callback,
+                                                  gpointer             user_data);
+GWeatherLocation *weather_tz_get_world_finish    (GAsyncResult        *result,
+                                                  GError             **error);
+WeatherTzDB      *weather_tz_get_default_db      (void);
+CityIndex        *weather_tz_get_city_index      (void);
 
 #endif /* __WEATHER_TZ_H */